@@ -23,7 +23,9 @@
 
 #include <sstream>
 #include <cstdio>
+#include <sys/stat.h>
 #include <apt-pkg/algorithms.h>
+#include <apt-pkg/configuration.h>
 #include <apt-pkg/progress.h>
 #include <apt-pkg/upgrade.h>
 
@@ -34,6 +36,7 @@ using namespace APT;
 
 AptCacheFile::AptCacheFile(PkBackendJob *job) :
     m_packageRecords(0),
+    m_applicationsIndexed(false),
     m_job(job)
 {
 }
@@ -46,11 +49,38 @@ AptCacheFile::~AptCacheFile()
 bool AptCacheFile::Open(bool withLock)
 {
     OpPackageKitProgress progress(m_job);
-    return pkgCacheFile::Open(&progress, withLock);
+    if (!pkgCacheFile::Open(&progress, withLock)) {
+        return false;
+    }
+
+    // pkgcache.bin is regenerated after every dpkg run, rebuild the
+    // summaries then rather than reading the records until the next
+    // refresh. Locking jobs are about to run dpkg themselves.
+    if (!m_summaries.open(GetPkgCache()) && !withLock &&
+            AptSummaryIndex::build(*this)) {
+        m_summaries.open(GetPkgCache());
+    }
+
+    // Package ids repeat the origin of a few package files over and
+    // over, compute it once per file
+    pkgCache *cache = GetPkgCache();
+    m_originIds.assign(cache->HeaderP->PackageFileCount, std::string());
+    for (pkgCache::PkgFileIterator file = cache->FileBegin(); !file.end(); ++file) {
+        if (file->ID < m_originIds.size()) {
+            m_originIds[file->ID] = utilBuildPackageOriginId(file);
+        }
+    }
+    return true;
 }
 
 void AptCacheFile::Close()
 {
+    m_summaries.close();
+    m_originIds.clear();
+    m_packagesById.clear();
+    m_versionsById.clear();
+    m_verAttributes.clear();
+    m_applicationsIndexed = false;
     delete m_packageRecords;
 
     m_packageRecords = 0;
@@ -62,6 +92,34 @@ void AptCacheFile::Close()
     _error->Discard();
 }
 
+void AptCacheFile::setJob(PkBackendJob *job)
+{
+    m_job = job;
+}
+
+std::string AptCacheFile::sourcesStamp()
+{
+    const std::string files[] = {
+        _config->FindFile("Dir::Cache::pkgcache"),
+        _config->FindFile("Dir::Cache::srcpkgcache"),
+        _config->FindFile("Dir::State::status"),
+        _config->FindFile("Dir::Etc::Preferences"),
+        _config->FindDir("Dir::Etc::PreferencesParts")
+    };
+
+    std::stringstream stamp;
+    for (const std::string &file : files) {
+        struct stat buf;
+        if (file.empty() || stat(file.c_str(), &buf) != 0) {
+            stamp << "-;";
+            continue;
+        }
+        stamp << buf.st_ino << ':' << buf.st_size << ':'
+              << buf.st_mtim.tv_sec << '.' << buf.st_mtim.tv_nsec << ';';
+    }
+    return stamp.str();
+}
+
 bool AptCacheFile::BuildCaches(bool withLock)
 {
     OpPackageKitProgress progress(m_job);
@@ -411,9 +469,78 @@ pkgCache::VerIterator AptCacheFile::findCandidateVer(const pkgCache::PkgIterator
     return (*this)[pkg].CandidateVerIter(*this);
 }
 
+const gchar* AptCacheFile::buildPackageId(const pkgCache::VerIterator &ver, std::string &packageId) const
+{
+    const pkgCache::PkgIterator &pkg = ver.ParentPkg();
+    packageId.assign(pkg.Name());
+    packageId.push_back(';');
+    packageId.append(ver.VerStr());
+    packageId.push_back(';');
+    if (ver.Arch() != NULL) {
+        packageId.append(ver.Arch());
+    }
+    packageId.push_back(';');
+
+    // when a package is installed, the data part of a package-id is "installed:<repo-id>"
+    if (pkg->CurrentState == pkgCache::State::Installed && pkg.CurrentVer() == ver) {
+        packageId.append("installed:");
+    }
+
+    const pkgCache::VerFileIterator vf = ver.FileList();
+    if (vf.end()) {
+        packageId.append("local");
+    } else if (vf.File()->ID < m_originIds.size()) {
+        packageId.append(m_originIds[vf.File()->ID]);
+    } else {
+        packageId.append(utilBuildPackageOriginId(vf));
+    }
+    return packageId.c_str();
+}
+
+void AptCacheFile::buildIdTables()
+{
+    pkgCache *cache = GetPkgCache();
+    m_packagesById.assign(cache->HeaderP->PackageCount, nullptr);
+    m_versionsById.assign(cache->HeaderP->VersionCount, nullptr);
+    for (pkgCache::PkgIterator pkg = cache->PkgBegin(); !pkg.end(); ++pkg) {
+        if (pkg->ID < m_packagesById.size()) {
+            m_packagesById[pkg->ID] = pkg;
+        }
+        for (pkgCache::VerIterator ver = pkg.VersionList(); !ver.end(); ++ver) {
+            if (ver->ID < m_versionsById.size()) {
+                m_versionsById[ver->ID] = ver;
+            }
+        }
+    }
+}
+
+pkgCache::PkgIterator AptCacheFile::findPackageById(guint32 id)
+{
+    if (m_packagesById.empty()) {
+        buildIdTables();
+    }
+
+    if (id >= m_packagesById.size() || m_packagesById[id] == nullptr) {
+        return pkgCache::PkgIterator();
+    }
+    return pkgCache::PkgIterator(*GetPkgCache(), m_packagesById[id]);
+}
+
+pkgCache::VerIterator AptCacheFile::findVersionById(guint32 id)
+{
+    if (m_versionsById.empty()) {
+        buildIdTables();
+    }
+
+    if (id >= m_versionsById.size() || m_versionsById[id] == nullptr) {
+        return pkgCache::VerIterator();
+    }
+    return pkgCache::VerIterator(*GetPkgCache(), m_versionsById[id]);
+}
+
 std::string AptCacheFile::getShortDescription(const pkgCache::VerIterator &ver)
 {
-    if (ver.end() || ver.FileList().end() || GetPkgRecords() == 0) {
+    if (ver.end() || ver.FileList().end()) {
         return string();
     }
 
@@ -422,11 +549,35 @@ std::string AptCacheFile::getShortDescription(const pkgCache::VerIterator &ver)
         return string();
     }
 
+    string summary;
+    if (m_summaries.find(d, summary) || GetPkgRecords() == 0) {
+        return summary;
+    }
+
+    return getShortDescription(ver, *m_packageRecords);
+}
+
+std::string AptCacheFile::getShortDescription(const pkgCache::VerIterator &ver, pkgRecords &records) const
+{
+    if (ver.end() || ver.FileList().end()) {
+        return string();
+    }
+
+    pkgCache::DescIterator d = ver.TranslatedDescription();
+    if (d.end()) {
+        return string();
+    }
+
+    string summary;
+    if (m_summaries.find(d, summary)) {
+        return summary;
+    }
+
     pkgCache::DescFileIterator df = d.FileList();
     if (df.end()) {
         return string();
     } else {
-        return m_packageRecords->Lookup(df).ShortDesc();
+        return records.Lookup(df).ShortDesc();
     }
 }
 
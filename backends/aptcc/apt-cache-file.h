@@ -25,6 +25,11 @@
 #include <apt-pkg/cachefile.h>
 #include <pk-backend.h>
 
+#include <string>
+#include <vector>
+
+#include "apt-summary-index.h"
+
 class pkgProblemResolver;
 class AptCacheFile : public pkgCacheFile
 {
@@ -42,6 +47,19 @@ public:
       */
     void Close();
 
+    /**
+      * Reports the progress and errors of the cache to \a job, used when
+      * the cache of a previous job is reused
+      */
+    void setJob(PkBackendJob *job);
+
+    /**
+      * Describes the state of the files the cache is built from
+      * (pkgcache.bin, srcpkgcache.bin, the dpkg status and preferences),
+      * a cache opened while the stamp was different is outdated
+      */
+    static std::string sourcesStamp();
+
     /**
       * Build caches
       */
@@ -113,11 +131,53 @@ public:
      */
     pkgCache::VerIterator findVer(const pkgCache::PkgIterator &pkg);
 
+    /**
+      * Finds the package whose pkgCache::Package::ID is \a id, as stored
+      * by the on-disk indexes. The ID is a counter, not the position of
+      * the package in the map, so the table is built on first use.
+      * @returns pkgCache::PkgIterator, if .end() is true there is no such package
+      */
+    pkgCache::PkgIterator findPackageById(guint32 id);
+
+    /**
+      * Finds the version whose pkgCache::Version::ID is \a id
+      * @returns pkgCache::VerIterator, if .end() is true there is no such version
+      */
+    pkgCache::VerIterator findVersionById(guint32 id);
+
+    /**
+      * Builds the package id of \a ver into \a packageId, reusing its
+      * buffer. The repository origins are computed once per package
+      * file when the cache is opened, so this doesn't allocate once the
+      * buffer is large enough.
+      * @returns the contents of \a packageId
+      */
+    const gchar* buildPackageId(const pkgCache::VerIterator &ver, std::string &packageId) const;
+
+    /**
+      * The filter attributes of every version, indexed by its ID. They
+      * are filled by the first job that filters and kept with the cache,
+      * so jobs reusing it don't compute them again.
+      */
+    inline std::vector<guint8>& versionAttributes() { return m_verAttributes; }
+
+    /**
+      * Whether the application attribute of the versions was taken from
+      * the file index
+      */
+    inline bool applicationsIndexed() const { return m_applicationsIndexed; }
+    inline void setApplicationsIndexed(bool indexed) { m_applicationsIndexed = indexed; }
+
     /** \return a short description string corresponding to the given
      *  version.
      */
     std::string getShortDescription(const pkgCache::VerIterator &ver);
 
+    /** \return a short description string corresponding to the given
+     *  version, read from \a records so threads can use their own
+     */
+    std::string getShortDescription(const pkgCache::VerIterator &ver, pkgRecords &records) const;
+
     /** \return a short description string corresponding to the given
      *  version.
      */
@@ -137,9 +197,16 @@ public:
 
 private:
     void buildPkgRecords();
+    void buildIdTables();
     static std::string debParser(std::string descr);
 
     pkgRecords *m_packageRecords;
+    AptSummaryIndex m_summaries;
+    std::vector<std::string> m_originIds;
+    std::vector<pkgCache::Package*> m_packagesById;
+    std::vector<pkgCache::Version*> m_versionsById;
+    std::vector<guint8> m_verAttributes;
+    bool m_applicationsIndexed;
     PkBackendJob *m_job;
 };
 
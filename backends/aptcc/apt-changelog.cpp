@@ -0,0 +1,156 @@
+/* apt-changelog.cpp - Parsed changelogs of the available updates
+ *
+ * Copyright (c) 2026 The PackageKit authors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include "apt-changelog.h"
+
+#include <glib/gstdio.h>
+
+#include <algorithm>
+
+#include "apt-index-file.h"
+#include "apt-utils.h"
+
+#define CHANGELOG_GROUP "Changelog"
+
+// Changelogs not read for that long are most likely for updates that
+// were installed since
+#define CHANGELOG_MAX_AGE (30 * 24 * 60 * 60)
+
+static string changelogPath(const string &srcpkg, const char *candVersion, const char *currVersion)
+{
+    string name = srcpkg + "_" + candVersion + "_" + currVersion;
+    std::replace(name.begin(), name.end(), '/', '_');
+    return AptIndexFile::path("changelogs") + "/" + name;
+}
+
+static vector<string> urlList(GPtrArray *urls)
+{
+    vector<string> ret;
+    for (guint i = 0; i < urls->len; ++i) {
+        gchar *url = static_cast<gchar*>(g_ptr_array_index(urls, i));
+        if (url != NULL) {
+            ret.push_back(url);
+            g_free(url);
+        }
+    }
+    g_ptr_array_unref(urls);
+    return ret;
+}
+
+static vector<string> loadList(GKeyFile *file, const gchar *key)
+{
+    vector<string> ret;
+    g_auto(GStrv) values = g_key_file_get_string_list(file, CHANGELOG_GROUP, key, NULL, NULL);
+    for (guint i = 0; values != NULL && values[i] != NULL; ++i) {
+        ret.push_back(values[i]);
+    }
+    return ret;
+}
+
+static void saveList(GKeyFile *file, const gchar *key, const vector<string> &values)
+{
+    vector<const gchar*> list;
+    for (const string &value : values) {
+        list.push_back(value.c_str());
+    }
+    g_key_file_set_string_list(file, CHANGELOG_GROUP, key, list.data(), list.size());
+}
+
+void AptChangelog::parse(const string &fileName, const string &srcpkg, const pkgCache::VerIterator &currver)
+{
+    changelog = parseChangelog(fileName,
+                               srcpkg,
+                               currver,
+                               &updateText,
+                               &updated,
+                               &issued);
+    bugzillaUrls = urlList(getBugzillaUrls(changelog));
+    cveUrls = urlList(getCVEUrls(changelog));
+}
+
+bool AptChangelog::load(const string &srcpkg, const char *candVersion, const char *currVersion)
+{
+    const string path = changelogPath(srcpkg, candVersion, currVersion);
+    g_autoptr(GKeyFile) file = g_key_file_new();
+    if (!g_key_file_load_from_file(file, path.c_str(), G_KEY_FILE_NONE, NULL)) {
+        return false;
+    }
+
+    g_autofree gchar *text = g_key_file_get_string(file, CHANGELOG_GROUP, "Text", NULL);
+    if (text == NULL) {
+        return false;
+    }
+
+    g_autofree gchar *update = g_key_file_get_string(file, CHANGELOG_GROUP, "UpdateText", NULL);
+    g_autofree gchar *issuedDate = g_key_file_get_string(file, CHANGELOG_GROUP, "Issued", NULL);
+    g_autofree gchar *updatedDate = g_key_file_get_string(file, CHANGELOG_GROUP, "Updated", NULL);
+    changelog = text;
+    updateText = update ? update : "";
+    issued = issuedDate ? issuedDate : "";
+    updated = updatedDate ? updatedDate : "";
+    bugzillaUrls = loadList(file, "BugzillaUrls");
+    cveUrls = loadList(file, "CveUrls");
+
+    // Keep it from being pruned while the update is pending
+    g_utime(path.c_str(), NULL);
+    return true;
+}
+
+void AptChangelog::save(const string &srcpkg, const char *candVersion, const char *currVersion) const
+{
+    const string path = changelogPath(srcpkg, candVersion, currVersion);
+    g_autofree gchar *dir = g_path_get_dirname(path.c_str());
+    if (g_mkdir_with_parents(dir, 0755) != 0) {
+        g_warning("Failed to create %s", dir);
+        return;
+    }
+
+    g_autoptr(GKeyFile) file = g_key_file_new();
+    g_key_file_set_string(file, CHANGELOG_GROUP, "Text", changelog.c_str());
+    g_key_file_set_string(file, CHANGELOG_GROUP, "UpdateText", updateText.c_str());
+    g_key_file_set_string(file, CHANGELOG_GROUP, "Issued", issued.c_str());
+    g_key_file_set_string(file, CHANGELOG_GROUP, "Updated", updated.c_str());
+    saveList(file, "BugzillaUrls", bugzillaUrls);
+    saveList(file, "CveUrls", cveUrls);
+
+    g_autoptr(GError) error = NULL;
+    if (!g_key_file_save_to_file(file, path.c_str(), &error)) {
+        g_warning("Failed to save changelog %s: %s", path.c_str(), error->message);
+    }
+}
+
+void AptChangelog::prune()
+{
+    const string dir = AptIndexFile::path("changelogs");
+    g_autoptr(GDir) changelogs = g_dir_open(dir.c_str(), 0, NULL);
+    if (changelogs == NULL) {
+        return;
+    }
+
+    const gint64 now = g_get_real_time() / G_USEC_PER_SEC;
+    const gchar *name;
+    while ((name = g_dir_read_name(changelogs)) != NULL) {
+        const string path = dir + "/" + name;
+        GStatBuf buf;
+        if (g_stat(path.c_str(), &buf) == 0 && now - buf.st_mtime > CHANGELOG_MAX_AGE) {
+            g_unlink(path.c_str());
+        }
+    }
+}
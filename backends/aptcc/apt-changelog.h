@@ -0,0 +1,72 @@
+/* apt-changelog.h - Parsed changelogs of the available updates
+ *
+ * Copyright (c) 2026 The PackageKit authors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef APT_CHANGELOG_H
+#define APT_CHANGELOG_H
+
+#include <apt-pkg/pkgcache.h>
+
+#include <string>
+#include <vector>
+
+using std::string;
+using std::vector;
+
+/**
+ * The parts of a changelog shown in the update details
+ *
+ * Parsed changelogs are kept in APTCC_INDEX_DIR/changelogs, keyed by
+ * the source package, the candidate and the installed version, so the
+ * details of an update are only downloaded and parsed once.
+ */
+class AptChangelog
+{
+public:
+    /**
+     * Parses the downloaded changelog of \a srcpkg, \a fileName may be
+     * empty if the download failed
+     */
+    void parse(const string &fileName, const string &srcpkg, const pkgCache::VerIterator &currver);
+
+    /**
+     * Loads the changelog stored by save()
+     * @returns false if it isn't cached
+     */
+    bool load(const string &srcpkg, const char *candVersion, const char *currVersion);
+
+    /**
+     * Stores the changelog for the next load()
+     */
+    void save(const string &srcpkg, const char *candVersion, const char *currVersion) const;
+
+    /**
+     * Removes the changelogs that weren't used for a while
+     */
+    static void prune();
+
+    string changelog;
+    string updateText;
+    string issued;
+    string updated;
+    vector<string> bugzillaUrls;
+    vector<string> cveUrls;
+};
+
+#endif // APT_CHANGELOG_H
@@ -0,0 +1,289 @@
+/* apt-file-index.cpp - Index of the files owned by installed packages
+ *
+ * Copyright (c) 2026 The PackageKit authors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include "apt-file-index.h"
+#include "apt-utils.h"
+
+#include <glib/gstdio.h>
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <unordered_map>
+#include <dirent.h>
+
+#define FILE_INDEX_MAGIC   "PKFIL\0\0\1"
+#define FILE_INDEX_NAME    "files.idx"
+
+// The index starts with four words: the number of list files, the
+// number of paths, the size of the string pool and a spare one. Then
+// follow the list files as { name, mtime, mtime nsec, size }, the paths
+// sorted by their reversed bytes as { offset, length, list } and the
+// string pool holding the package names and the reversed paths.
+#define HEADER_WORDS 4
+#define LIST_WORDS   4
+#define ENTRY_WORDS  3
+
+typedef struct {
+    guint32 offset;
+    guint32 length;
+    guint32 list;
+} PathEntry;
+
+static int comparePath(const gchar *path, guint32 length, const string &key)
+{
+    int ret = memcmp(path, key.data(), std::min<size_t>(length, key.size()));
+    if (ret != 0) {
+        return ret;
+    }
+    return length < key.size() ? -1 : (length > key.size() ? 1 : 0);
+}
+
+bool AptFileIndex::open()
+{
+    return m_file.open(AptIndexFile::path(FILE_INDEX_NAME), FILE_INDEX_MAGIC, utilDpkgInfoDir()) &&
+            map();
+}
+
+bool AptFileIndex::map()
+{
+    const guint32 *words = reinterpret_cast<const guint32*>(m_file.data());
+    const gsize count = m_file.size() / sizeof(guint32);
+    if (count < HEADER_WORDS ||
+            count < HEADER_WORDS + gsize(words[0]) * LIST_WORDS + gsize(words[1]) * ENTRY_WORDS ||
+            m_file.size() < (HEADER_WORDS + gsize(words[0]) * LIST_WORDS +
+                             gsize(words[1]) * ENTRY_WORDS) * sizeof(guint32) + words[2]) {
+        g_debug("Ignoring invalid file index");
+        m_file.close();
+        return false;
+    }
+
+    m_listCount = words[0];
+    m_entryCount = words[1];
+    m_stringsSize = words[2];
+    m_lists = words + HEADER_WORDS;
+    m_entries = m_lists + m_listCount * LIST_WORDS;
+    m_strings = reinterpret_cast<const gchar*>(m_entries + m_entryCount * ENTRY_WORDS);
+
+    // Check every offset once so lookups don't have to
+    bool valid = m_stringsSize == 0 || m_strings[m_stringsSize - 1] == '\0';
+    for (guint32 i = 0; valid && i < m_listCount; ++i) {
+        valid = m_lists[i * LIST_WORDS] < m_stringsSize;
+    }
+    for (guint32 i = 0; valid && i < m_entryCount; ++i) {
+        const guint32 *entry = m_entries + i * ENTRY_WORDS;
+        valid = gsize(entry[0]) + entry[1] <= m_stringsSize && entry[2] < m_listCount;
+    }
+
+    if (!valid) {
+        g_debug("File index is corrupted");
+        m_file.close();
+        return false;
+    }
+    return true;
+}
+
+bool AptFileIndex::update()
+{
+    const string infoDir = utilDpkgInfoDir();
+    GStatBuf before;
+    if (g_stat(infoDir.c_str(), &before) != 0) {
+        return false;
+    }
+
+    // Group the paths of the previous index by list file, so the
+    // ones whose list didn't change can be copied over
+    std::unordered_map<string, guint32> previous;
+    vector<vector<guint32> > previousEntries;
+    if (m_file.open(AptIndexFile::path(FILE_INDEX_NAME), FILE_INDEX_MAGIC) && map()) {
+        previousEntries.resize(m_listCount);
+        for (guint32 i = 0; i < m_listCount; ++i) {
+            previous[m_strings + m_lists[i * LIST_WORDS]] = i;
+        }
+        for (guint32 i = 0; i < m_entryCount; ++i) {
+            previousEntries[m_entries[i * ENTRY_WORDS + 2]].push_back(i);
+        }
+    }
+
+    DIR *dp;
+    struct dirent *dirp;
+    if (!(dp = opendir(infoDir.c_str()))) {
+        g_debug("Error opening %s", infoDir.c_str());
+        m_file.close();
+        return false;
+    }
+
+    vector<guint32> lists;
+    vector<PathEntry> entries;
+    string strings;
+    string line;
+    guint reused = 0;
+    while ((dirp = readdir(dp)) != NULL) {
+        if (!g_str_has_suffix(dirp->d_name, ".list")) {
+            continue;
+        }
+
+        const string file = infoDir + dirp->d_name;
+        GStatBuf buf;
+        if (g_stat(file.c_str(), &buf) != 0) {
+            continue;
+        }
+
+        const string name(dirp->d_name, strlen(dirp->d_name) - 5);
+        const guint32 list = lists.size() / LIST_WORDS;
+        lists.push_back(strings.size());
+        lists.push_back(buf.st_mtim.tv_sec);
+        lists.push_back(buf.st_mtim.tv_nsec);
+        lists.push_back(buf.st_size);
+        strings.append(name);
+        strings.push_back('\0');
+
+        auto it = previous.find(name);
+        if (it != previous.end()) {
+            const guint32 *old = m_lists + it->second * LIST_WORDS;
+            if (old[1] == lists[list * LIST_WORDS + 1] &&
+                    old[2] == lists[list * LIST_WORDS + 2] &&
+                    old[3] == lists[list * LIST_WORDS + 3]) {
+                for (guint32 i : previousEntries[it->second]) {
+                    const guint32 *entry = m_entries + i * ENTRY_WORDS;
+                    entries.push_back({ guint32(strings.size()), entry[1], list });
+                    strings.append(m_strings + entry[0], entry[1]);
+                }
+                ++reused;
+                continue;
+            }
+        }
+
+        std::ifstream in(file.c_str());
+        while (getline(in, line)) {
+            if (line.empty()) {
+                continue;
+            }
+            entries.push_back({ guint32(strings.size()), guint32(line.size()), list });
+            strings.append(line.rbegin(), line.rend());
+        }
+    }
+    closedir(dp);
+    m_file.close();
+
+    GStatBuf after;
+    if (g_stat(infoDir.c_str(), &after) != 0 ||
+            after.st_mtim.tv_sec != before.st_mtim.tv_sec ||
+            after.st_mtim.tv_nsec != before.st_mtim.tv_nsec) {
+        g_debug("dpkg database changed while indexing files");
+        return false;
+    }
+
+    g_debug("Updating file index, reused %u of %zu list files",
+            reused, lists.size() / LIST_WORDS);
+
+    std::sort(entries.begin(), entries.end(),
+              [&strings](const PathEntry &a, const PathEntry &b) {
+        int ret = memcmp(strings.data() + a.offset, strings.data() + b.offset,
+                         std::min(a.length, b.length));
+        return ret != 0 ? ret < 0 : a.length < b.length;
+    });
+
+    // Terminate the pool so package names can't run past its end
+    strings.push_back('\0');
+
+    vector<guint32> index;
+    index.reserve(HEADER_WORDS + lists.size() + entries.size() * ENTRY_WORDS);
+    index.push_back(lists.size() / LIST_WORDS);
+    index.push_back(entries.size());
+    index.push_back(strings.size());
+    index.push_back(0);
+    index.insert(index.end(), lists.begin(), lists.end());
+    for (const PathEntry &entry : entries) {
+        index.push_back(entry.offset);
+        index.push_back(entry.length);
+        index.push_back(entry.list);
+    }
+
+    string contents(reinterpret_cast<const char*>(index.data()),
+                    index.size() * sizeof(guint32));
+    contents.append(strings);
+    if (!AptIndexFile::save(AptIndexFile::path(FILE_INDEX_NAME),
+                            FILE_INDEX_MAGIC,
+                            infoDir,
+                            contents)) {
+        return false;
+    }
+
+    return open();
+}
+
+bool AptFileIndex::find(gchar **values, vector<string> &packages) const
+{
+    if (!m_file.isOpen()) {
+        return false;
+    }
+
+    vector<bool> owners(m_listCount, false);
+    for (uint i = 0; i < g_strv_length(values); ++i) {
+        const gchar *value = values[i];
+        if (strlen(value) < 1) {
+            continue;
+        }
+
+        // The values used to be matched as regular expressions, leave
+        // anything that isn't a plain path to the caller
+        if (strpbrk(value, "^$*+?()[]{}|\\") != NULL) {
+            return false;
+        }
+
+        string key(value);
+        std::reverse(key.begin(), key.end());
+        findRange(key, value[0] == '/', owners);
+    }
+
+    for (guint32 i = 0; i < m_listCount; ++i) {
+        if (owners[i]) {
+            packages.push_back(m_strings + m_lists[i * LIST_WORDS]);
+        }
+    }
+    return true;
+}
+
+void AptFileIndex::findRange(const string &key, bool exact, vector<bool> &owners) const
+{
+    guint32 low = 0;
+    guint32 high = m_entryCount;
+    while (low < high) {
+        guint32 middle = low + (high - low) / 2;
+        const guint32 *entry = m_entries + middle * ENTRY_WORDS;
+        if (comparePath(m_strings + entry[0], entry[1], key) < 0) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+
+    // Paths ending with the key follow, the exact match first
+    for (guint32 i = low; i < m_entryCount; ++i) {
+        const guint32 *entry = m_entries + i * ENTRY_WORDS;
+        if (entry[1] < key.size() ||
+                memcmp(m_strings + entry[0], key.data(), key.size()) != 0 ||
+                (exact && entry[1] != key.size())) {
+            break;
+        }
+        owners[entry[2]] = true;
+    }
+}
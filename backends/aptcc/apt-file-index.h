@@ -0,0 +1,78 @@
+/* apt-file-index.h - Index of the files owned by installed packages
+ *
+ * Copyright (c) 2026 The PackageKit authors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef APT_FILE_INDEX_H
+#define APT_FILE_INDEX_H
+
+#include <glib.h>
+
+#include <string>
+#include <vector>
+
+#include "apt-index-file.h"
+
+using std::string;
+using std::vector;
+
+/**
+ * Maps the paths listed in the dpkg info/<package>.list files to the
+ * packages owning them.
+ *
+ * Paths are stored reversed and sorted, so both exact paths and path
+ * suffixes are found with a binary search. The index is tied to the
+ * dpkg info directory, when it changes update() only reads the list
+ * files that were modified since.
+ */
+class AptFileIndex
+{
+public:
+    /**
+     * Maps the index if it is up to date with the dpkg database
+     */
+    bool open();
+
+    /**
+     * Writes a new index reusing the unchanged entries of the current
+     * one, and maps it
+     */
+    bool update();
+
+    /**
+     * Fills \a packages with the names of the packages owning a file
+     * matching one of the values, either a full path or a suffix of it
+     * @returns false if the index can't answer the query, the caller
+     * must fall back to reading the list files
+     */
+    bool find(gchar **values, vector<string> &packages) const;
+
+private:
+    bool map();
+    void findRange(const string &key, bool exact, vector<bool> &owners) const;
+
+    AptIndexFile m_file;
+    const guint32 *m_lists = nullptr;
+    guint32 m_listCount = 0;
+    const guint32 *m_entries = nullptr;
+    guint32 m_entryCount = 0;
+    const gchar *m_strings = nullptr;
+    guint32 m_stringsSize = 0;
+};
+
+#endif // APT_FILE_INDEX_H
@@ -0,0 +1,208 @@
+/* apt-gst-index.cpp - Index of the GStreamer capabilities of packages
+ *
+ * Copyright (c) 2026 The PackageKit authors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include "apt-gst-index.h"
+
+#include <apt-pkg/configuration.h>
+#include <apt-pkg/fileutl.h>
+#include <apt-pkg/pkgrecords.h>
+
+#include <cstring>
+#include <vector>
+
+#include "apt-cache-file.h"
+#include "apt-utils.h"
+
+#define GST_INDEX_MAGIC   "PKGST\0\0\1"
+#define GST_INDEX_NAME    "gstreamer.idx"
+
+// The index starts with four words: the package count of the cache it
+// was built from, the number of entries, the size of the string pool
+// and a spare one. The entries follow as { package, fields offset,
+// fields length, arch offset } into the string pool.
+#define HEADER_WORDS 4
+#define ENTRY_WORDS  4
+
+static string gstIndexSource()
+{
+    return _config->FindFile("Dir::Cache::pkgcache");
+}
+
+/**
+ * Appends the Gstreamer-* fields of a record, with their continuation
+ * lines, to \a fields
+ */
+static void collectFields(const char *start, const char *stop, string &fields)
+{
+    static const char prefix[] = "\nGstreamer-";
+    const char *line = start;
+    while ((line = static_cast<const char*>(memmem(line, stop - line,
+                                                   prefix, sizeof(prefix) - 1))) != nullptr) {
+        const char *end = line + 1;
+        for (;;) {
+            const char *eol = static_cast<const char*>(memchr(end, '\n', stop - end));
+            if (eol == nullptr) {
+                end = stop;
+                break;
+            }
+            end = eol;
+            if (end + 1 == stop || (end[1] != ' ' && end[1] != '\t')) {
+                break;
+            }
+            ++end;
+        }
+        fields.append(line, end - line);
+        line = end;
+    }
+}
+
+bool AptGstIndex::open(pkgCache *cache)
+{
+    const string source = gstIndexSource();
+    if (source.empty() ||
+            !m_file.open(AptIndexFile::path(GST_INDEX_NAME), GST_INDEX_MAGIC, source)) {
+        return false;
+    }
+
+    const guint32 *words = reinterpret_cast<const guint32*>(m_file.data());
+    const gsize count = m_file.size() / sizeof(guint32);
+    if (count < HEADER_WORDS ||
+            words[0] != cache->HeaderP->PackageCount ||
+            m_file.size() < (HEADER_WORDS + gsize(words[1]) * ENTRY_WORDS) * sizeof(guint32) + words[2]) {
+        g_debug("Ignoring invalid gstreamer index");
+        m_file.close();
+        return false;
+    }
+
+    m_count = words[1];
+    const guint32 stringsSize = words[2];
+    m_entries = words + HEADER_WORDS;
+    m_strings = reinterpret_cast<const gchar*>(m_entries + m_count * ENTRY_WORDS);
+
+    // Check every offset once so lookups don't have to
+    bool valid = stringsSize == 0 || m_strings[stringsSize - 1] == '\0';
+    for (guint32 i = 0; valid && i < m_count; ++i) {
+        const guint32 *entry = m_entries + i * ENTRY_WORDS;
+        valid = entry[0] < words[0] &&
+                gsize(entry[1]) + entry[2] <= stringsSize &&
+                entry[3] < stringsSize;
+    }
+
+    if (!valid) {
+        g_debug("Gstreamer index is corrupted");
+        m_file.close();
+        return false;
+    }
+    return true;
+}
+
+guint32 AptGstIndex::count() const
+{
+    return m_count;
+}
+
+guint32 AptGstIndex::package(guint32 i) const
+{
+    return m_entries[i * ENTRY_WORDS];
+}
+
+void AptGstIndex::fields(guint32 i, const char *&start, const char *&stop) const
+{
+    const guint32 *entry = m_entries + i * ENTRY_WORDS;
+    start = m_strings + entry[1];
+    stop = start + entry[2];
+}
+
+const gchar* AptGstIndex::arch(guint32 i) const
+{
+    return m_strings + m_entries[i * ENTRY_WORDS + 3];
+}
+
+bool AptGstIndex::build(AptCacheFile &cache)
+{
+    const string source = gstIndexSource();
+    if (source.empty() || !FileExists(source)) {
+        return false;
+    }
+
+    pkgCache *pkgs = cache.GetPkgCache();
+    pkgRecords *records = cache.GetPkgRecords();
+    if (pkgs == nullptr || records == nullptr) {
+        return false;
+    }
+
+    std::vector<guint32> entries;
+    string strings;
+    string fields;
+    for (pkgCache::PkgIterator pkg = pkgs->PkgBegin(); !pkg.end(); ++pkg) {
+        // Ignore packages that exist only due to dependencies.
+        if (pkg.VersionList().end() && pkg.ProvidesList().end()) {
+            continue;
+        }
+
+        // Ignore debug packages - these aren't interesting as codec providers,
+        // but they do have apt GStreamer-* metadata.
+        if (ends_with (pkg.Name(), "-dbg") || ends_with (pkg.Name(), "-dbgsym")) {
+            continue;
+        }
+
+        pkgCache::VerIterator ver = cache.findVer(pkg);
+        if (ver.end()) {
+            ver = cache.findCandidateVer(pkg);
+            if (ver.end()) {
+                continue;
+            }
+        }
+
+        const char *start, *stop;
+        records->Lookup(ver.FileList()).GetRec(start, stop);
+        fields.clear();
+        collectFields(start, stop, fields);
+        if (fields.empty()) {
+            continue;
+        }
+
+        entries.push_back(pkg->ID);
+        entries.push_back(strings.size());
+        entries.push_back(fields.size());
+        strings.append(fields);
+        entries.push_back(strings.size());
+        strings.append(ver.Arch());
+        strings.push_back('\0');
+    }
+
+    g_debug("Indexing the gstreamer fields of %zu packages", entries.size() / ENTRY_WORDS);
+
+    std::vector<guint32> index;
+    index.reserve(HEADER_WORDS + entries.size());
+    index.push_back(pkgs->HeaderP->PackageCount);
+    index.push_back(entries.size() / ENTRY_WORDS);
+    index.push_back(strings.size());
+    index.push_back(0);
+    index.insert(index.end(), entries.begin(), entries.end());
+
+    string contents(reinterpret_cast<const char*>(index.data()),
+                    index.size() * sizeof(guint32));
+    contents.append(strings);
+    return AptIndexFile::save(AptIndexFile::path(GST_INDEX_NAME),
+                              GST_INDEX_MAGIC,
+                              source,
+                              contents);
+}
@@ -0,0 +1,83 @@
+/* apt-gst-index.h - Index of the GStreamer capabilities of packages
+ *
+ * Copyright (c) 2026 The PackageKit authors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef APT_GST_INDEX_H
+#define APT_GST_INDEX_H
+
+#include <glib.h>
+#include <apt-pkg/pkgcache.h>
+
+#include <string>
+
+#include "apt-index-file.h"
+
+using std::string;
+
+class AptCacheFile;
+
+/**
+ * Holds the Gstreamer-* fields of the few packages having them, so
+ * codec lookups don't read the record of every package.
+ *
+ * Like the search index, it is tied to the pkgcache.bin it was built
+ * from and refers to packages by their ID. It is rebuilt on refresh
+ * only, after a dpkg run codec lookups read the package records until
+ * then.
+ */
+class AptGstIndex
+{
+public:
+    /**
+     * Maps the index if it was built from the given cache
+     */
+    bool open(pkgCache *cache);
+
+    guint32 count() const;
+
+    /**
+     * The ID of the package of entry \a i
+     */
+    guint32 package(guint32 i) const;
+
+    /**
+     * Sets [start, stop) to the Gstreamer-* lines of entry \a i, each
+     * preceded by a newline as in the package record
+     */
+    void fields(guint32 i, const char *&start, const char *&stop) const;
+
+    /**
+     * The architecture of the version entry \a i was taken from
+     */
+    const gchar* arch(guint32 i) const;
+
+    /**
+     * Writes a new index from the installed or candidate version of
+     * every package
+     */
+    static bool build(AptCacheFile &cache);
+
+private:
+    AptIndexFile m_file;
+    const guint32 *m_entries = nullptr;
+    guint32 m_count = 0;
+    const gchar *m_strings = nullptr;
+};
+
+#endif // APT_GST_INDEX_H
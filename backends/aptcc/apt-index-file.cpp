@@ -0,0 +1,165 @@
+/* apt-index-file.cpp - On-disk indexes built from the APT cache
+ *
+ * Copyright (c) 2026 The PackageKit authors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include "apt-index-file.h"
+
+#include <glib/gstdio.h>
+#include <apt-pkg/configuration.h>
+
+#include <cstring>
+
+typedef struct {
+    gchar   magic[8];
+    gint64  sourceMtime;
+    gint64  sourceMtimeNsec;
+    guint64 sourceSize;
+} IndexHeader;
+
+static bool stampSource(const std::string &source, IndexHeader &header)
+{
+    GStatBuf buf;
+    if (g_stat(source.c_str(), &buf) != 0) {
+        return false;
+    }
+
+    header.sourceMtime = buf.st_mtim.tv_sec;
+    header.sourceMtimeNsec = buf.st_mtim.tv_nsec;
+    header.sourceSize = buf.st_size;
+    return true;
+}
+
+AptIndexFile::AptIndexFile() :
+    m_file(nullptr)
+{
+}
+
+AptIndexFile::~AptIndexFile()
+{
+    close();
+}
+
+bool AptIndexFile::open(const std::string &path, const char *magic)
+{
+    close();
+
+    m_file = g_mapped_file_new(path.c_str(), FALSE, NULL);
+    if (m_file == nullptr) {
+        return false;
+    }
+
+    if (g_mapped_file_get_length(m_file) < sizeof(IndexHeader)) {
+        g_debug("Ignoring truncated index %s", path.c_str());
+        close();
+        return false;
+    }
+
+    const IndexHeader *header;
+    header = reinterpret_cast<const IndexHeader*>(g_mapped_file_get_contents(m_file));
+    if (memcmp(header->magic, magic, sizeof(header->magic)) != 0) {
+        g_debug("Ignoring index %s of another format", path.c_str());
+        close();
+        return false;
+    }
+
+    return true;
+}
+
+bool AptIndexFile::open(const std::string &path, const char *magic, const std::string &source)
+{
+    IndexHeader current;
+    if (!stampSource(source, current)) {
+        close();
+        return false;
+    }
+
+    if (!open(path, magic)) {
+        return false;
+    }
+
+    const IndexHeader *header;
+    header = reinterpret_cast<const IndexHeader*>(g_mapped_file_get_contents(m_file));
+    if (header->sourceMtime != current.sourceMtime ||
+            header->sourceMtimeNsec != current.sourceMtimeNsec ||
+            header->sourceSize != current.sourceSize) {
+        g_debug("Ignoring stale index %s", path.c_str());
+        close();
+        return false;
+    }
+
+    return true;
+}
+
+void AptIndexFile::close()
+{
+    if (m_file) {
+        g_mapped_file_unref(m_file);
+        m_file = nullptr;
+    }
+}
+
+bool AptIndexFile::isOpen() const
+{
+    return m_file != nullptr;
+}
+
+const gchar* AptIndexFile::data() const
+{
+    return g_mapped_file_get_contents(m_file) + sizeof(IndexHeader);
+}
+
+gsize AptIndexFile::size() const
+{
+    return g_mapped_file_get_length(m_file) - sizeof(IndexHeader);
+}
+
+bool AptIndexFile::save(const std::string &path,
+                        const char *magic,
+                        const std::string &source,
+                        const std::string &contents)
+{
+    IndexHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, magic, sizeof(header.magic));
+    if (!stampSource(source, header)) {
+        return false;
+    }
+
+    g_autofree gchar *dir = g_path_get_dirname(path.c_str());
+    if (g_mkdir_with_parents(dir, 0755) != 0) {
+        g_warning("Failed to create %s", dir);
+        return false;
+    }
+
+    std::string data(reinterpret_cast<const char*>(&header), sizeof(header));
+    data.append(contents);
+
+    g_autoptr(GError) error = NULL;
+    if (!g_file_set_contents(path.c_str(), data.data(), data.size(), &error)) {
+        g_warning("Failed to write index %s: %s", path.c_str(), error->message);
+        return false;
+    }
+
+    return true;
+}
+
+std::string AptIndexFile::path(const char *name)
+{
+    return _config->FindDir("Dir::Cache::PackageKit", APTCC_INDEX_DIR) + name;
+}
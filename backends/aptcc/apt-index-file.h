@@ -0,0 +1,88 @@
+/* apt-index-file.h - On-disk indexes built from the APT cache
+ *
+ * Copyright (c) 2026 The PackageKit authors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef APT_INDEX_FILE_H
+#define APT_INDEX_FILE_H
+
+#include <glib.h>
+
+#include <string>
+
+#define APTCC_INDEX_DIR LOCALSTATEDIR "/cache/PackageKit/aptcc"
+
+/**
+ * A read only, memory mapped index file
+ *
+ * Every index starts with a small header holding a magic string and
+ * the modification time and size of the file it was built from, an
+ * index whose source changed since is considered stale and refused.
+ */
+class AptIndexFile
+{
+public:
+    AptIndexFile();
+    ~AptIndexFile();
+
+    /**
+     * Maps the index at the given path
+     * @param magic 8 bytes identifying the index format
+     * @param source the file the index was built from
+     * @returns false if the index is missing, of another format or stale
+     */
+    bool open(const std::string &path, const char *magic, const std::string &source);
+
+    /**
+     * Maps the index at the given path without checking whether it is
+     * stale, used to update an index incrementally
+     */
+    bool open(const std::string &path, const char *magic);
+
+    /**
+     * Unmaps the index
+     */
+    void close();
+
+    bool isOpen() const;
+
+    /**
+     * The index contents following the header, aligned to 8 bytes
+     */
+    const gchar* data() const;
+    gsize size() const;
+
+    /**
+     * Atomically writes a new index for the given source file
+     */
+    static bool save(const std::string &path,
+                     const char *magic,
+                     const std::string &source,
+                     const std::string &contents);
+
+    /**
+     * The full path of the index named \a name, in APTCC_INDEX_DIR
+     * unless Dir::Cache::PackageKit says otherwise
+     */
+    static std::string path(const char *name);
+
+private:
+    GMappedFile *m_file;
+};
+
+#endif // APT_INDEX_FILE_H
@@ -29,51 +29,151 @@
 #include <apt-pkg/algorithms.h>
 #include <apt-pkg/pkgsystem.h>
 #include <apt-pkg/version.h>
+#include <apt-pkg/aptconfiguration.h>
+#include <apt-pkg/hashes.h>
 
 #include <appstream.h>
 
 #include <sys/statvfs.h>
 #include <sys/statfs.h>
 #include <sys/wait.h>
+#include <poll.h>
 #include <sys/fcntl.h>
 #include <pty.h>
 
+#include <atomic>
 #include <iostream>
 #include <memory>
+#include <deque>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <unordered_map>
 #include <fstream>
 #include <dirent.h>
 
 #include "apt-cache-file.h"
+#include "apt-update-snapshot.h"
 #include "apt-utils.h"
 #include "gst-matcher.h"
 #include "apt-messages.h"
 #include "acqpkitstatus.h"
 #include "deb-file.h"
+#include "apt-search-index.h"
+#include "apt-file-index.h"
+#include "apt-soname-index.h"
+#include "apt-gst-index.h"
 
 using namespace APT;
 
 #define RAMFS_MAGIC     0x858458f6
 
+// The cache of the last query job, reused by the next one as long as
+// the files it was built from didn't change. A job takes it for itself
+// so concurrent jobs never share a cache.
+static std::mutex idleCacheMutex;
+static AptCacheFile *idleCache = nullptr;
+static string idleCacheStamp;
+
 AptIntf::AptIntf(PkBackendJob *job) :
     m_job(job),
     m_cancel(false),
     m_terminalTimeout(120),
     m_lastSubProgress(0),
-    m_cache(0)
+    m_cache(0),
+    m_cacheReusable(false)
 {
     m_cancel = false;
 }
 
+AptCacheFile* AptIntf::takeIdleCache(const string &stamp)
+{
+    std::lock_guard<std::mutex> lock(idleCacheMutex);
+    AptCacheFile *cache = idleCache;
+    idleCache = nullptr;
+    if (cache != nullptr && idleCacheStamp != stamp) {
+        g_debug("Package cache is outdated");
+        delete cache;
+        cache = nullptr;
+    }
+    return cache;
+}
+
+void AptIntf::releaseCache()
+{
+    AptCacheFile *cache = m_cache;
+    m_cache = nullptr;
+    if (cache == nullptr) {
+        return;
+    }
+
+    // Keep the cache for the next job unless this one changed it
+    if (m_cacheReusable) {
+        pkgDepCache *depCache = cache->GetDepCache();
+        m_cacheReusable = depCache != nullptr &&
+                depCache->InstCount() == 0 &&
+                depCache->DelCount() == 0 &&
+                depCache->BrokenCount() == 0 &&
+                AptCacheFile::sourcesStamp() == m_cacheStamp;
+    }
+    if (!m_cacheReusable) {
+        delete cache;
+        return;
+    }
+
+    cache->setJob(nullptr);
+    std::lock_guard<std::mutex> lock(idleCacheMutex);
+    delete idleCache;
+    idleCache = cache;
+    idleCacheStamp = m_cacheStamp;
+}
+
+void AptIntf::freeIdleCache()
+{
+    std::lock_guard<std::mutex> lock(idleCacheMutex);
+    delete idleCache;
+    idleCache = nullptr;
+}
+
+bool AptIntf::canRunInParallel(PkRoleEnum role)
+{
+    switch (role) {
+    case PK_ROLE_ENUM_SEARCH_NAME:
+    case PK_ROLE_ENUM_SEARCH_DETAILS:
+    case PK_ROLE_ENUM_SEARCH_FILE:
+    case PK_ROLE_ENUM_SEARCH_GROUP:
+    case PK_ROLE_ENUM_RESOLVE:
+    case PK_ROLE_ENUM_GET_DETAILS:
+    case PK_ROLE_ENUM_GET_FILES:
+    case PK_ROLE_ENUM_DEPENDS_ON:
+    case PK_ROLE_ENUM_REQUIRED_BY:
+    case PK_ROLE_ENUM_GET_PACKAGES:
+    case PK_ROLE_ENUM_GET_UPDATE_DETAIL:
+        return true;
+    default:
+        return false;
+    }
+}
+
 bool AptIntf::init(gchar **localDebs)
 {
     const gchar *locale;
     const gchar *http_proxy;
     const gchar *ftp_proxy;
 
-    m_isMultiArch = APT::Configuration::getArchitectures(false).size() > 1;
+    // Jobs running in parallel must not change the process wide state,
+    // they were only started in parallel if the locale and proxies are
+    // already the ones they need
+    PkRoleEnum role = pk_backend_job_get_role(m_job);
+    const bool parallel = canRunInParallel(role);
+
+    m_isMultiArch = APT::Configuration::getArchitectures(parallel).size() > 1;
 
     // set locale
-    if (locale = pk_backend_job_get_locale(m_job)) {
+    locale = pk_backend_job_get_locale(m_job);
+    if (locale != NULL && g_strcmp0(setlocale(LC_ALL, NULL), locale) != 0) {
         setlocale(LC_ALL, locale);
         // TODO why this cuts characters on ui?
         // 		string _locale(locale);
@@ -85,18 +185,17 @@ bool AptIntf::init(gchar **localDebs)
 
     // set http proxy
     http_proxy = pk_backend_job_get_proxy_http(m_job);
-    if (http_proxy != NULL)
+    if (http_proxy != NULL && g_strcmp0(g_getenv("http_proxy"), http_proxy) != 0)
         setenv("http_proxy", http_proxy, 1);
 
     // set ftp proxy
     ftp_proxy = pk_backend_job_get_proxy_ftp(m_job);
-    if (ftp_proxy != NULL)
+    if (ftp_proxy != NULL && g_strcmp0(g_getenv("ftp_proxy"), ftp_proxy) != 0)
         setenv("ftp_proxy", ftp_proxy, 1);
 
     // Check if we should open the Cache with lock
     bool withLock;
     bool AllowBroken = false;
-    PkRoleEnum role = pk_backend_job_get_role(m_job);
     switch (role) {
     case PK_ROLE_ENUM_INSTALL_PACKAGES:
     case PK_ROLE_ENUM_INSTALL_FILES:
@@ -121,33 +220,52 @@ bool AptIntf::init(gchar **localDebs)
         withLock = !simulate;
     }
 
-    // Create the AptCacheFile class to search for packages
-    m_cache = new AptCacheFile(m_job);
-    if (localDebs) {
-        for (int i = 0; i < g_strv_length(localDebs); ++i) {
-            markFileForInstall(localDebs[i]);
-        }
+    // Jobs that neither lock nor add local packages can start with the
+    // cache of the previous one
+    m_cacheReusable = !withLock && !AllowBroken && localDebs == NULL;
+    if (m_cacheReusable) {
+        m_cacheStamp = AptCacheFile::sourcesStamp();
+        m_cache = takeIdleCache(m_cacheStamp);
     }
 
-    int timeout = 10;
-    // TODO test this
-    while (m_cache->Open(withLock) == false) {
-        if (withLock == false || (timeout <= 0)) {
-            show_errors(m_job, PK_ERROR_ENUM_CANNOT_GET_LOCK);
-            return false;
-        } else {
-            _error->Discard();
-            pk_backend_job_set_status(m_job, PK_STATUS_ENUM_WAITING_FOR_LOCK);
-            sleep(1);
-            timeout--;
+    const bool reused = m_cache != nullptr;
+    if (reused) {
+        g_debug("Reusing the package cache");
+        m_cache->setJob(m_job);
+    } else {
+        // Create the AptCacheFile class to search for packages
+        m_cache = new AptCacheFile(m_job);
+        if (localDebs) {
+            for (int i = 0; i < g_strv_length(localDebs); ++i) {
+                markFileForInstall(localDebs[i]);
+            }
+        }
+
+        int timeout = 10;
+        // TODO test this
+        while (m_cache->Open(withLock) == false) {
+            if (withLock == false || (timeout <= 0)) {
+                show_errors(m_job, PK_ERROR_ENUM_CANNOT_GET_LOCK);
+                return false;
+            } else {
+                _error->Discard();
+                pk_backend_job_set_status(m_job, PK_STATUS_ENUM_WAITING_FOR_LOCK);
+                sleep(1);
+                timeout--;
+            }
+
+            // Close the cache if we are going to try again
+            m_cache->Close();
         }
 
-        // Close the cache if we are going to try again
-        m_cache->Close();
+        // Opening may have regenerated pkgcache.bin
+        if (m_cacheReusable) {
+            m_cacheStamp = AptCacheFile::sourcesStamp();
+        }
     }
 
     m_interactive = pk_backend_job_get_interactive(m_job);
-    if (!m_interactive) {
+    if (!m_interactive && !parallel) {
         // Do not ask about config updates if we are not interactive
         _config->Set("Dpkg::Options::", "--force-confdef");
         _config->Set("Dpkg::Options::", "--force-confold");
@@ -156,19 +274,23 @@ bool AptIntf::init(gchar **localDebs)
         setenv("APT_LISTBUGS_FRONTEND", "none", 1);
     }
 
+    // A reused cache was checked by the job that opened it
+    if (reused) {
+        return true;
+    }
+
     // Check if there are half-installed packages and if we can fix them
     return m_cache->CheckDeps(AllowBroken);
 }
 
 AptIntf::~AptIntf()
 {
-    delete m_cache;
+    releaseCache();
 }
 
 void AptIntf::cancel()
 {
-    if (!m_cancel) {
-        m_cancel = true;
+    if (!m_cancel.exchange(true)) {
         pk_backend_job_set_status(m_job, PK_STATUS_ENUM_CANCEL);
     }
 
@@ -185,36 +307,18 @@ bool AptIntf::cancelled() const
 bool AptIntf::matchPackage(const pkgCache::VerIterator &ver, PkBitfield filters)
 {
     if (filters != 0) {
-        const pkgCache::PkgIterator &pkg = ver.ParentPkg();
-        bool installed = false;
-
-        // Check if the package is installed
-        if (pkg->CurrentState == pkgCache::State::Installed && pkg.CurrentVer() == ver) {
-            installed = true;
-        }
+        const guint8 attributes = versionAttributes(ver);
+        const bool installed = attributes & VER_INSTALLED;
 
         // if we are on multiarch check also the arch filter
         if (m_isMultiArch && pk_bitfield_contain(filters, PK_FILTER_ENUM_ARCH)/* && !installed*/) {
             // don't emit the package if it does not match
             // the native architecture
-            if (strcmp(ver.Arch(), "all") != 0 &&
-                    strcmp(ver.Arch(), _config->Find("APT::Architecture").c_str()) != 0) {
+            if (!(attributes & VER_NATIVE_ARCH)) {
                 return false;
             }
         }
 
-        std::string str = ver.Section() == NULL ? "" : ver.Section();
-        std::string section, component;
-
-        size_t found;
-        found = str.find_last_of("/");
-        section = str.substr(found + 1);
-        if(found == str.npos) {
-            component = "main";
-        } else {
-            component = str.substr(0, found);
-        }
-
         if (pk_bitfield_contain(filters, PK_FILTER_ENUM_NOT_INSTALLED) && installed) {
             return false;
         } else if (pk_bitfield_contain(filters, PK_FILTER_ENUM_INSTALLED) && !installed) {
@@ -222,48 +326,32 @@ bool AptIntf::matchPackage(const pkgCache::VerIterator &ver, PkBitfield filters)
         }
 
         if (pk_bitfield_contain(filters, PK_FILTER_ENUM_DEVELOPMENT)) {
-            // if ver.end() means unknow
-            // strcmp will be true when it's different than devel
-            std::string pkgName = pkg.Name();
-            if (!ends_with(pkgName, "-dev") &&
-                    !ends_with(pkgName, "-dbg") &&
-                    section.compare("devel") &&
-                    section.compare("libdevel")) {
+            if (!(attributes & VER_DEVEL)) {
                 return false;
             }
         } else if (pk_bitfield_contain(filters, PK_FILTER_ENUM_NOT_DEVELOPMENT)) {
-            std::string pkgName = pkg.Name();
-            if (ends_with(pkgName, "-dev") ||
-                    ends_with(pkgName, "-dbg") ||
-                    !section.compare("devel") ||
-                    !section.compare("libdevel")) {
+            if (attributes & VER_DEVEL) {
                 return false;
             }
         }
 
         if (pk_bitfield_contain(filters, PK_FILTER_ENUM_GUI)) {
-            // if ver.end() means unknow
-            // strcmp will be true when it's different than x11
-            if (section.compare("x11") && section.compare("gnome") &&
-                    section.compare("kde") && section.compare("graphics")) {
+            if (!(attributes & VER_GUI)) {
                 return false;
             }
         } else if (pk_bitfield_contain(filters, PK_FILTER_ENUM_NOT_GUI)) {
-            if (!section.compare("x11") || !section.compare("gnome") ||
-                    !section.compare("kde") || !section.compare("graphics")) {
+            if (attributes & VER_GUI) {
                 return false;
             }
         }
 
         if (pk_bitfield_contain(filters, PK_FILTER_ENUM_FREE)) {
-            if (component.compare("main") != 0 &&
-                    component.compare("universe") != 0) {
+            if (!(attributes & VER_FREE)) {
                 // Must be in main and universe to be free
                 return false;
             }
         } else if (pk_bitfield_contain(filters, PK_FILTER_ENUM_NOT_FREE)) {
-            if (component.compare("main") == 0 ||
-                    component.compare("universe") == 0) {
+            if (attributes & VER_FREE) {
                 // Must not be in main or universe to be free
                 return false;
             }
@@ -271,26 +359,27 @@ bool AptIntf::matchPackage(const pkgCache::VerIterator &ver, PkBitfield filters)
 
         // Check for supported packages
         if (pk_bitfield_contain(filters, PK_FILTER_ENUM_SUPPORTED)) {
-            if (!packageIsSupported(ver, component)) {
+            if (!(attributes & VER_SUPPORTED)) {
                 return false;
             }
         } else if (pk_bitfield_contain(filters, PK_FILTER_ENUM_NOT_SUPPORTED)) {
-            if (packageIsSupported(ver, component)) {
+            if (attributes & VER_SUPPORTED) {
                 return false;
             }
         }
 
         // Check for applications, if they have files with .desktop
-        if (pk_bitfield_contain(filters, PK_FILTER_ENUM_APPLICATION)) {
+        if (pk_bitfield_contain(filters, PK_FILTER_ENUM_APPLICATION) ||
+                pk_bitfield_contain(filters, PK_FILTER_ENUM_NOT_APPLICATION)) {
             // We do not support checking if it is an Application
             // if NOT installed
-            if (!installed || !isApplication(ver)) {
+            if (!installed) {
                 return false;
             }
-        } else if (pk_bitfield_contain(filters, PK_FILTER_ENUM_NOT_APPLICATION)) {
-            // We do not support checking if it is an Application
-            // if NOT installed
-            if (!installed || isApplication(ver)) {
+
+            bool application = m_cache->applicationsIndexed() ?
+                        (attributes & VER_APPLICATION) != 0 : isApplication(ver);
+            if (application != pk_bitfield_contain(filters, PK_FILTER_ENUM_APPLICATION)) {
                 return false;
             }
         }
@@ -328,63 +417,58 @@ PkgList AptIntf::filterPackages(const PkgList &packages, PkBitfield filters)
 
         // This filter is more complex so we filter it after the list has shrunk
         if (pk_bitfield_contain(filters, PK_FILTER_ENUM_DOWNLOADED) && ret.size() > 0) {
-            PkgList downloaded;
-
-            pkgProblemResolver Fix(*m_cache);
-            {
-                pkgDepCache::ActionGroup group(*m_cache);
-                for (auto autoInst : { true, false }) {
-                    for (const pkgCache::VerIterator &ver : ret) {
-                        if (m_cancel) {
-                            break;
-                        }
-
-                        m_cache->tryToInstall(Fix, ver, false, autoInst, false);
-                    }
-                }
-            }
-
-            // get a fetcher
-            pkgAcquire fetcher;
+            return filterDownloaded(ret);
+        }
 
-            // Read the source list
-            if (m_cache->BuildSourceList() == false) {
-                return downloaded;
-            }
+        return ret;
+    } else {
+        return packages;
+    }
+}
 
-            // Create the package manager and prepare to download
-            std::unique_ptr<pkgPackageManager> PM (_system->CreatePM(*m_cache));
-            if (!PM->GetArchives(&fetcher, m_cache->GetSourceList(), m_cache->GetPkgRecords()) ||
-                    _error->PendingError() == true) {
-                return downloaded;
-            }
+PkgList AptIntf::filterDownloaded(const PkgList &packages)
+{
+    PkgList downloaded;
 
-            for (const pkgCache::VerIterator &verIt : ret) {
-                bool found = false;
-                for (pkgAcquire::ItemIterator it = fetcher.ItemsBegin(); it < fetcher.ItemsEnd(); ++it) {
-                    pkgAcqArchiveSane *archive = static_cast<pkgAcqArchiveSane*>(dynamic_cast<pkgAcqArchive*>(*it));
-                    if (archive == nullptr) {
-                        continue;
-                    }
-                    const pkgCache::VerIterator ver = archive->version();
-                    if ((*it)->Local && verIt == ver) {
-                        found = true;
-                        break;
-                    }
-                }
+    // Sizes of the archives in the cache, by file name without extension
+    std::unordered_map<string, off_t> archives;
+    const string directory = _config->FindDir("Dir::Cache::Archives");
+    DIR *dp = opendir(directory.c_str());
+    if (dp == NULL) {
+        return downloaded;
+    }
 
-                if (found) {
-                    downloaded.push_back(verIt);
-                }
-            }
+    struct dirent *dirp;
+    while ((dirp = readdir(dp)) != NULL) {
+        const char *extension = strrchr(dirp->d_name, '.');
+        struct stat buf;
+        if (extension == NULL ||
+                fstatat(dirfd(dp), dirp->d_name, &buf, 0) != 0 ||
+                !S_ISREG(buf.st_mode)) {
+            continue;
+        }
+        archives[string(dirp->d_name, extension - dirp->d_name)] = buf.st_size;
+    }
+    closedir(dp);
 
-            return downloaded;
+    for (const pkgCache::VerIterator &ver : packages) {
+        // Installed versions have nothing to download
+        if (ver.ParentPkg().CurrentVer() == ver) {
+            continue;
         }
 
-        return ret;
-    } else {
-        return packages;
+        // The name getArchive() and pkgAcqArchive store the file as,
+        // like them consider an archive of the expected size complete
+        const string name = QuoteString(ver.ParentPkg().Name(), "_:") + '_' +
+                QuoteString(ver.VerStr(), "_:") + '_' +
+                QuoteString(ver.Arch(), "_:.");
+        auto it = archives.find(name);
+        if (it != archives.end() && it->second == off_t(ver->Size)) {
+            downloaded.push_back(ver);
+        }
     }
+
+    return downloaded;
 }
 
 // used to emit packages it collects all the needed info
@@ -402,21 +486,18 @@ void AptIntf::emitPackage(const pkgCache::VerIterator &ver, PkInfoEnum state)
         }
     }
 
-    gchar *package_id;
-    package_id = utilBuildPackageId(ver);
     pk_backend_job_package(m_job,
                            state,
-                           package_id,
+                           m_cache->buildPackageId(ver, m_packageId),
                            m_cache->getShortDescription(ver).c_str());
-    g_free(package_id);
 }
 
 void AptIntf::emitPackageProgress(const pkgCache::VerIterator &ver, PkStatusEnum status, uint percentage)
 {
-    gchar *package_id;
-    package_id = utilBuildPackageId(ver);
-    pk_backend_job_set_item_progress(m_job, package_id, status, percentage);
-    g_free(package_id);
+    pk_backend_job_set_item_progress(m_job,
+                                     m_cache->buildPackageId(ver, m_packageId),
+                                     status,
+                                     percentage);
 }
 
 void AptIntf::emitPackages(PkgList &output, PkBitfield filters, PkInfoEnum state)
@@ -446,10 +527,9 @@ void AptIntf::emitRequireRestart(PkgList &output)
     output.removeDuplicates();
 
     for (const pkgCache::VerIterator &verIt : output) {
-        gchar *package_id;
-        package_id = utilBuildPackageId(verIt);
-        pk_backend_job_require_restart(m_job, PK_RESTART_ENUM_SYSTEM, package_id);
-        g_free(package_id);
+        pk_backend_job_require_restart(m_job,
+                                       PK_RESTART_ENUM_SYSTEM,
+                                       m_cache->buildPackageId(verIt, m_packageId));
     }
 }
 
@@ -498,15 +578,44 @@ void AptIntf::emitUpdates(PkgList &output, PkBitfield filters)
 // search packages which provide a codec (specified in "values")
 void AptIntf::providesCodec(PkgList &output, gchar **values)
 {
-    string arch;
-    GstMatcher *matcher = new GstMatcher(values);
-    if (!matcher->hasMatches()) {
+    GstMatcher matcher(values);
+    if (!matcher.hasMatches()) {
+        return;
+    }
+
+    // Only look at the packages having Gstreamer-* fields
+    AptGstIndex index;
+    pkgCache *cache = m_cache->GetPkgCache();
+    if (index.open(cache)) {
+        for (guint32 i = 0; i < index.count(); ++i) {
+            if (m_cancel) {
+                break;
+            }
+
+            const char *start, *stop;
+            index.fields(i, start, stop);
+            if (!matcher.matches(start, stop, index.arch(i))) {
+                continue;
+            }
+
+            const pkgCache::PkgIterator pkg = m_cache->findPackageById(index.package(i));
+            if (pkg.end()) {
+                continue;
+            }
+            pkgCache::VerIterator ver = m_cache->findVer(pkg);
+            if (ver.end()) {
+                ver = m_cache->findCandidateVer(pkg);
+                if (ver.end()) {
+                    continue;
+                }
+            }
+            output.push_back(ver);
+        }
         return;
     }
 
     for (pkgCache::PkgIterator pkg = m_cache->GetPkgCache()->PkgBegin(); !pkg.end(); ++pkg) {
         if (m_cancel) {
-            delete matcher;
             break;
         }
 
@@ -524,7 +633,6 @@ void AptIntf::providesCodec(PkgList &output, gchar **values)
         // TODO search in updates packages
         // Ignore virtual packages
         pkgCache::VerIterator ver = m_cache->findVer(pkg);
-        arch = string(ver.Arch());
         if (ver.end() == true) {
             ver = m_cache->findCandidateVer(pkg);
             if (ver.end() == true) {
@@ -536,13 +644,41 @@ void AptIntf::providesCodec(PkgList &output, gchar **values)
         pkgRecords::Parser &rec = m_cache->GetPkgRecords()->Lookup(vf);
         const char *start, *stop;
         rec.GetRec(start, stop);
-        string record(start, stop - start);
-        if (matcher->matches(record, arch)) {
+        if (matcher.matches(start, stop, ver.Arch())) {
             output.push_back(ver);
         }
     }
+}
+
+void AptIntf::providesPackage(PkgList &output, const string &name)
+{
+    // Name may not be a valid package name, in that case FindGrp comes
+    // back with a bad group
+    pkgCache::GrpIterator grp = (*m_cache)->FindGrp(name);
+    for (pkgCache::PkgIterator pkg = grp.PackageList();
+         grp.IsGood() && pkg.end() == false;
+         pkg = grp.NextPkg(pkg)) {
+        pkgCache::VerIterator ver = m_cache->findVer(pkg);
+        if (ver.end()) {
+            ver = m_cache->findCandidateVer(pkg);
+        }
+        if (ver.end() == false) {
+            output.push_back(ver);
+            continue;
+        }
 
-    delete matcher;
+        // A virtual package, e.g. the previous name of a library package
+        // renamed for an ABI transition, add what provides it
+        for (pkgCache::PrvIterator Prv = pkg.ProvidesList(); Prv.end() == false; ++Prv) {
+            pkgCache::VerIterator ownerVer = m_cache->findVer(Prv.OwnerPkg());
+            if (ownerVer.end()) {
+                ownerVer = m_cache->findCandidateVer(Prv.OwnerPkg());
+            }
+            if (ownerVer.end() == false) {
+                output.push_back(ownerVer);
+            }
+        }
+    }
 }
 
 // search packages which provide the libraries specified in "values"
@@ -569,6 +705,9 @@ void AptIntf::providesLibrary(PkgList &output, gchar **values)
         return;
     }
 
+    AptSonameIndex index;
+    index.open();
+
     gchar *value;
     for (uint i = 0; i < g_strv_length(values); i++) {
         value = values[i];
@@ -587,37 +726,43 @@ void AptIntf::providesLibrary(PkgList &output, gchar **values)
                 libPkgName.append (strvalue.substr (pos + 4));
             }
 
-            g_debug ("pkg-name: %s", libPkgName.c_str ());
-
-            for (pkgCache::PkgIterator pkg = m_cache->GetPkgCache()->PkgBegin(); !pkg.end(); ++pkg) {
-                // Ignore packages that exist only due to dependencies.
-                if (pkg.VersionList().end() && pkg.ProvidesList().end()) {
-                    continue;
-                }
-
-                // TODO: Ignore virtual packages
-                pkgCache::VerIterator ver = m_cache->findVer(pkg);
-                if (ver.end()) {
-                    ver = m_cache->findCandidateVer(pkg);
-                    if (ver.end()) {
-                        continue;
-                    }
-                }
+            // Make everything lower-case
+            std::transform(libPkgName.begin(), libPkgName.end(), libPkgName.begin(), ::tolower);
 
-                // Make everything lower-case
-                std::transform(libPkgName.begin(), libPkgName.end(), libPkgName.begin(), ::tolower);
+            g_debug ("pkg-name: %s", libPkgName.c_str ());
 
-                if (g_strcmp0 (pkg.Name (), libPkgName.c_str ()) == 0) {
-                    output.push_back(ver);
+            // Besides the package named after the library, look up the
+            // packages the Contents files list as shipping it
+            vector<string> names;
+            names.push_back(libPkgName);
+            index.find(value, names);
+            for (const string &name : names) {
+                if (m_cancel) {
+                    break;
                 }
+                providesPackage(output, name);
             }
         } else {
             g_debug("libmatcher: Did not match: %s", value);
         }
     }
+
+    regfree(&libreg);
 }
 
 // Mostly copied from pkgAcqArchive.
+/**
+ * The name getArchive() stores the archive of \a ver as,
+ * package_version_arch.foo with the extension of \a fileName
+ */
+static string archiveFileName(const pkgCache::VerIterator &ver, const string &fileName)
+{
+    return QuoteString(ver.ParentPkg().Name(), "_:") + '_' +
+            QuoteString(ver.VerStr(), "_:") + '_' +
+            QuoteString(ver.Arch(), "_:.") +
+            "." + flExtension(fileName);
+}
+
 bool AptIntf::getArchive(pkgAcquire *Owner,
                          const pkgCache::VerIterator &Version,
                          std::string directory,
@@ -650,11 +795,7 @@ bool AptIntf::getArchive(pkgAcquire *Owner,
             return false;
         }
 
-        // Generate the final file name as: package_version_arch.foo
-        StoreFilename = QuoteString(Version.ParentPkg().Name(),"_:") + '_' +
-                QuoteString(Version.VerStr(),"_:") + '_' +
-                QuoteString(Version.Arch(),"_:.") +
-                "." + flExtension(Parse.FileName());
+        StoreFilename = archiveFileName(Version, Parse.FileName());
     }
 
     for (; Vf.end() == false; Vf++) {
@@ -701,6 +842,71 @@ bool AptIntf::getArchive(pkgAcquire *Owner,
     return false;
 }
 
+vector<string> AptIntf::findArchives(const PkgList &versions, const string &directory)
+{
+    struct Candidate {
+        size_t index;
+        string path;
+        HashStringList hashes;
+    };
+
+    // The records aren't thread safe, look the hashes up first
+    vector<string> archives(versions.size());
+    vector<Candidate> candidates;
+    for (size_t i = 0; i < versions.size(); ++i) {
+        const pkgCache::VerIterator &ver = versions[i];
+        pkgCache::VerFileIterator vf = ver.FileList();
+        while (!vf.end() && (vf.File()->Flags & pkgCache::Flag::NotSource) != 0) {
+            ++vf;
+        }
+        if (vf.end() || ver.Arch() == 0) {
+            continue;
+        }
+
+        pkgRecords::Parser &parse = m_cache->GetPkgRecords()->Lookup(vf);
+        const HashStringList hashes = parse.Hashes();
+        const string path = directory + "/" + archiveFileName(ver, parse.FileName());
+        struct stat buf;
+        if (!hashes.usable() ||
+                stat(path.c_str(), &buf) != 0 ||
+                !S_ISREG(buf.st_mode) ||
+                buf.st_size != off_t(ver->Size)) {
+            continue;
+        }
+        candidates.push_back({ i, path, hashes });
+    }
+
+    if (candidates.empty()) {
+        return archives;
+    }
+
+    // Hashes sets libgcrypt up on first use, don't race on it
+    Hashes().GetHashStringList();
+
+    std::atomic<size_t> next(0);
+    const guint workerCount = CLAMP(std::thread::hardware_concurrency(), 1, MIN(candidates.size(), 8));
+    vector<std::thread> workers;
+    for (guint i = 0; i < workerCount; ++i) {
+        workers.emplace_back([&]() {
+            size_t candidate;
+            while (!m_cancel && (candidate = next++) < candidates.size()) {
+                const Candidate &archive = candidates[candidate];
+                if (archive.hashes.VerifyFile(archive.path)) {
+                    archives[archive.index] = archive.path;
+                } else {
+                    g_debug("Hash mismatch for %s", archive.path.c_str());
+                }
+            }
+        });
+    }
+
+    for (std::thread &worker : workers) {
+        worker.join();
+    }
+
+    return archives;
+}
+
 AptCacheFile* AptIntf::aptCacheFile() const
 {
     return m_cache;
@@ -731,18 +937,14 @@ void AptIntf::emitPackageDetail(const pkgCache::VerIterator &ver)
         size = ver->Size;
     }
 
-    gchar *package_id;
-    package_id = utilBuildPackageId(ver);
     pk_backend_job_details(m_job,
-                           package_id,
+                           m_cache->buildPackageId(ver, m_packageId),
                            m_cache->getShortDescription(ver).c_str(),
                            "unknown",
                            get_enum_group(section),
                            m_cache->getLongDescriptionParsed(ver).c_str(),
                            rec.Homepage().c_str(),
                            size);
-
-    g_free(package_id);
 }
 
 void AptIntf::emitDetails(PkgList &pkgs)
@@ -762,8 +964,26 @@ void AptIntf::emitDetails(PkgList &pkgs)
     }
 }
 
+string AptIntf::sourcePackage(const pkgCache::VerIterator &ver)
+{
+    pkgRecords::Parser &rec = m_cache->GetPkgRecords()->Lookup(ver.FileList());
+    if (rec.SourcePkg().empty()) {
+        return ver.ParentPkg().Name();
+    }
+    return rec.SourcePkg();
+}
+
+static gchar **urlArray(const vector<string> &urls)
+{
+    gchar **ret = g_new0(gchar *, urls.size() + 1);
+    for (size_t i = 0; i < urls.size(); ++i) {
+        ret[i] = g_strdup(urls[i].c_str());
+    }
+    return ret;
+}
+
 // used to emit packages it collects all the needed info
-void AptIntf::emitUpdateDetail(const pkgCache::VerIterator &candver)
+void AptIntf::emitUpdateDetail(const pkgCache::VerIterator &candver, const AptChangelog &changelog)
 {
     // Verify if our update version is valid
     if (candver.end()) {
@@ -777,52 +997,20 @@ void AptIntf::emitUpdateDetail(const pkgCache::VerIterator &candver)
     const pkgCache::VerIterator &currver = m_cache->findVer(pkg);
 
     // Build a package_id from the current version
-    gchar *current_package_id = utilBuildPackageId(currver);
+    string currentPackageId;
+    m_cache->buildPackageId(currver, currentPackageId);
 
     pkgCache::VerFileIterator vf = candver.FileList();
-    string origin = vf.File().Origin() == NULL ? "" : vf.File().Origin();
-    pkgRecords::Parser &rec = m_cache->GetPkgRecords()->Lookup(candver.FileList());
-
-    string changelog;
-    string update_text;
-    string updated;
-    string issued;
-    string srcpkg;
-    if (rec.SourcePkg().empty()) {
-        srcpkg = pkg.Name();
-    } else {
-        srcpkg = rec.SourcePkg();
-    }
-
-    PkBackend *backend = PK_BACKEND(pk_backend_job_get_backend(m_job));
-    if (pk_backend_is_online(backend)) {
-        // Create the download object
-        AcqPackageKitStatus Stat(this, m_job);
-
-        // get a fetcher
-        pkgAcquire fetcher;
-        fetcher.SetLog(&Stat);
-
-        // fetch the changelog
-        pk_backend_job_set_status(m_job, PK_STATUS_ENUM_DOWNLOAD_CHANGELOG);
-        changelog = fetchChangelogData(*m_cache,
-                                       fetcher,
-                                       candver,
-                                       currver,
-                                       &update_text,
-                                       &updated,
-                                       &issued);
-    }
 
     // Check if the update was updates since it was issued
-    if (issued.compare(updated) == 0) {
+    string updated = changelog.updated;
+    if (changelog.issued.compare(updated) == 0) {
         updated = "";
     }
 
     // Build a package_id from the update version
     string archive = vf.File().Archive() == NULL ? "" : vf.File().Archive();
-    gchar *package_id;
-    package_id = utilBuildPackageId(candver);
+    m_cache->buildPackageId(candver, m_packageId);
 
     PkUpdateStateEnum updateState = PK_UPDATE_STATE_ENUM_UNKNOWN;
     if (archive.compare("stable") == 0) {
@@ -839,45 +1027,143 @@ void AptIntf::emitUpdateDetail(const pkgCache::VerIterator &candver)
         restart = PK_RESTART_ENUM_SYSTEM;
     }
 
-    gchar **updates;
-    updates = (gchar **) g_malloc(2 * sizeof(gchar *));
-    updates[0] = current_package_id;
-    updates[1] = NULL;
+    gchar *updates[] = { const_cast<gchar*>(currentPackageId.c_str()), NULL };
 
-    GPtrArray *bugzilla_urls;
-    GPtrArray *cve_urls;
-    bugzilla_urls = getBugzillaUrls(changelog);
-    cve_urls = getCVEUrls(changelog);
+    gchar **bugzilla_urls = urlArray(changelog.bugzillaUrls);
+    gchar **cve_urls = urlArray(changelog.cveUrls);
 
     pk_backend_job_update_detail(m_job,
-                                 package_id,
+                                 m_packageId.c_str(),
                                  updates,//const gchar *updates
                                  NULL,//const gchar *obsoletes
                                  NULL,//const gchar *vendor_url
-                                 (gchar **) bugzilla_urls->pdata,// gchar **bugzilla_urls
-                                 (gchar **) cve_urls->pdata,// gchar **cve_urls
+                                 bugzilla_urls,// gchar **bugzilla_urls
+                                 cve_urls,// gchar **cve_urls
                                  restart,//PkRestartEnum restart
-                                 update_text.c_str(),//const gchar *update_text
-                                 changelog.c_str(),//const gchar *changelog
+                                 changelog.updateText.c_str(),//const gchar *update_text
+                                 changelog.changelog.c_str(),//const gchar *changelog
                                  updateState,//PkUpdateStateEnum state
-                                 issued.c_str(), //const gchar *issued_text
+                                 changelog.issued.c_str(), //const gchar *issued_text
                                  updated.c_str() //const gchar *updated_text
                                  );
 
-    g_free(package_id);
-    g_strfreev(updates);
-    g_ptr_array_unref(bugzilla_urls);
-    g_ptr_array_unref(cve_urls);
+    g_strfreev(bugzilla_urls);
+    g_strfreev(cve_urls);
 }
 
+/**
+ * Reports every changelog to the given callback as soon as it is
+ * downloaded or failed
+ */
+class AcqChangelogStatus : public AcqPackageKitStatus
+{
+public:
+    AcqChangelogStatus(AptIntf *apt,
+                       PkBackendJob *job,
+                       const std::function<void(pkgAcquire::Item *)> &finished) :
+        AcqPackageKitStatus(apt, job),
+        m_finished(finished)
+    {
+    }
+
+    void Done(pkgAcquire::ItemDesc &Itm) override
+    {
+        AcqPackageKitStatus::Done(Itm);
+        m_finished(Itm.Owner);
+    }
+
+    void Fail(pkgAcquire::ItemDesc &Itm) override
+    {
+        AcqPackageKitStatus::Fail(Itm);
+
+        // Idle items are going to be retried
+        if (Itm.Owner->Status != pkgAcquire::Item::StatIdle) {
+            m_finished(Itm.Owner);
+        }
+    }
+
+private:
+    std::function<void(pkgAcquire::Item *)> m_finished;
+};
+
 void AptIntf::emitUpdateDetails(const PkgList &pkgs)
 {
+    PkBackend *backend = PK_BACKEND(pk_backend_job_get_backend(m_job));
+    const bool online = pk_backend_is_online(backend);
+
+    // Changelogs parsed by a previous call are emitted right away, only
+    // the missing ones are downloaded
+    PkgList missing;
     for (const pkgCache::VerIterator &verIt : pkgs) {
         if (m_cancel) {
-            break;
+            return;
+        }
+        if (verIt.end()) {
+            continue;
+        }
+
+        const pkgCache::VerIterator &currver = m_cache->findVer(verIt.ParentPkg());
+        AptChangelog changelog;
+        if (changelog.load(sourcePackage(verIt),
+                           verIt.VerStr(),
+                           currver.end() ? "" : currver.VerStr())) {
+            emitUpdateDetail(verIt, changelog);
+        } else if (!online) {
+            emitUpdateDetail(verIt, AptChangelog());
+        } else {
+            missing.push_back(verIt);
+        }
+    }
+
+    if (missing.empty()) {
+        return;
+    }
+
+    // Queue every changelog in the same fetcher so they are downloaded
+    // in parallel, and emit each update as soon as its changelog is in
+    std::map<pkgAcquire::Item *, pkgCache::VerIterator> pending;
+    auto finished = [this, &pending](pkgAcquire::Item *item) {
+        auto it = pending.find(item);
+        if (it == pending.end()) {
+            return;
+        }
+
+        if (!m_cancel) {
+            const pkgCache::VerIterator &candver = it->second;
+            const pkgCache::VerIterator &currver = m_cache->findVer(candver.ParentPkg());
+            const string srcpkg = sourcePackage(candver);
+            const bool downloaded = item->Status == pkgAcquire::Item::StatDone;
+
+            AptChangelog changelog;
+            changelog.parse(downloaded ? item->DestFile : string(), srcpkg, currver);
+            if (downloaded) {
+                changelog.save(srcpkg,
+                               candver.VerStr(),
+                               currver.end() ? "" : currver.VerStr());
+            }
+            emitUpdateDetail(candver, changelog);
         }
+        pending.erase(it);
+    };
+
+    // Create the download object
+    AcqChangelogStatus Stat(this, m_job, finished);
+
+    // get a fetcher
+    pkgAcquire fetcher;
+    fetcher.SetLog(&Stat);
+
+    for (const pkgCache::VerIterator &verIt : missing) {
+        pending[new pkgAcqChangelog(&fetcher, verIt)] = verIt;
+    }
+
+    // fetch the changelogs
+    pk_backend_job_set_status(m_job, PK_STATUS_ENUM_DOWNLOAD_CHANGELOG);
+    fetcher.Run();
 
-        emitUpdateDetail(verIt);
+    // Changelogs that couldn't even be queued
+    while (!pending.empty() && !m_cancel) {
+        finished(pending.begin()->first);
     }
 }
 
@@ -885,28 +1171,41 @@ void AptIntf::getDepends(PkgList &output,
                          const pkgCache::VerIterator &ver,
                          bool recursive)
 {
-    pkgCache::DepIterator dep = ver.DependsList();
-    while (!dep.end()) {
+    // Keep our own stack of versions to visit, deep dependency
+    // closures would otherwise blow up the call stack
+    PkgSet seen(*m_cache->GetPkgCache());
+    if (recursive) {
+        seen.insert(output);
+    }
+
+    vector<pkgCache::VerIterator> pending;
+    pending.push_back(ver);
+    while (!pending.empty()) {
         if (m_cancel) {
             break;
         }
 
-        const pkgCache::VerIterator &ver = m_cache->findVer(dep.TargetPkg());
-        // Ignore packages that exist only due to dependencies.
-        if (ver.end()) {
-            dep++;
-            continue;
-        } else if (dep->Type == pkgCache::Dep::Depends) {
-            if (recursive) {
-                if (!output.contains(dep.TargetPkg())) {
-                    output.push_back(ver);
-                    getDepends(output, ver, recursive);
-                }
-            } else {
-                output.push_back(ver);
+        const pkgCache::VerIterator current = pending.back();
+        pending.pop_back();
+
+        for (pkgCache::DepIterator dep = current.DependsList(); !dep.end(); ++dep) {
+            if (dep->Type != pkgCache::Dep::Depends) {
+                continue;
+            }
+
+            const pkgCache::VerIterator &depVer = m_cache->findVer(dep.TargetPkg());
+            // Ignore packages that exist only due to dependencies.
+            if (depVer.end()) {
+                continue;
+            }
+
+            if (!recursive) {
+                output.push_back(depVer);
+            } else if (seen.insert(dep.TargetPkg())) {
+                output.push_back(depVer);
+                pending.push_back(depVer);
             }
         }
-        dep++;
     }
 }
 
@@ -914,61 +1213,180 @@ void AptIntf::getRequires(PkgList &output,
                           const pkgCache::VerIterator &ver,
                           bool recursive)
 {
-    for (pkgCache::PkgIterator parentPkg = m_cache->GetPkgCache()->PkgBegin(); !parentPkg.end(); ++parentPkg) {
+    // The cache already knows which dependencies point to each package,
+    // so walk the reverse dependencies instead of checking the depends of
+    // every package in the cache for each level
+    PkgSet seen(*m_cache->GetPkgCache());
+    if (recursive) {
+        seen.insert(output);
+    }
+
+    std::deque<pkgCache::VerIterator> queue;
+    queue.push_back(ver);
+    while (!queue.empty()) {
+        if (m_cancel) {
+            break;
+        }
+
+        const pkgCache::VerIterator current = queue.front();
+        queue.pop_front();
+
+        // getDepends() only reports the version findVer() picks, so other
+        // versions of the package are never required by anything
+        const pkgCache::PkgIterator &pkg = current.ParentPkg();
+        if (m_cache->findVer(pkg) != current) {
+            continue;
+        }
+
+        for (pkgCache::DepIterator dep = pkg.RevDependsList(); !dep.end(); ++dep) {
+            if (dep->Type != pkgCache::Dep::Depends) {
+                continue;
+            }
+
+            // Only the dependencies of the version we would show count
+            const pkgCache::PkgIterator &parentPkg = dep.ParentPkg();
+            const pkgCache::VerIterator &parentVer = m_cache->findVer(parentPkg);
+            if (parentVer.end() || dep.ParentVer() != parentVer) {
+                continue;
+            }
+
+            if (!seen.insert(parentPkg)) {
+                continue;
+            }
+
+            output.push_back(parentVer);
+            if (recursive) {
+                queue.push_back(parentVer);
+            }
+        }
+    }
+}
+
+PkgList AptIntf::getPackages()
+{
+    pk_backend_job_set_status(m_job, PK_STATUS_ENUM_QUERY);
+
+    PkgList output;
+    output.reserve(m_cache->GetPkgCache()->HeaderP->PackageCount);
+    for (pkgCache::PkgIterator pkg = m_cache->GetPkgCache()->PkgBegin(); !pkg.end(); ++pkg) {
         if (m_cancel) {
             break;
         }
 
         // Ignore packages that exist only due to dependencies.
-        if (parentPkg.VersionList().end() && parentPkg.ProvidesList().end()) {
+        if(pkg.VersionList().end() && pkg.ProvidesList().end()) {
             continue;
         }
 
-        // Don't insert virtual packages instead add what it provides
-        const pkgCache::VerIterator &parentVer = m_cache->findVer(parentPkg);
-        if (parentVer.end() == false) {
-            PkgList deps;
-            getDepends(deps, parentVer, false);
-            for (const pkgCache::VerIterator &depVer : deps) {
-                if (depVer == ver) {
-                    if (recursive) {
-                        if (!output.contains(parentPkg)) {
-                            output.push_back(parentVer);
-                            getRequires(output, parentVer, recursive);
-                        }
-                    } else {
-                        output.push_back(parentVer);
-                    }
-                    break;
+        // Don't insert virtual packages as they don't have all kinds of info
+        const pkgCache::VerIterator &ver = m_cache->findVer(pkg);
+        if (ver.end() == false) {
+            output.push_back(ver);
+        }
+    }
+    return output;
+}
+
+void AptIntf::emitAllPackages(PkBitfield filters)
+{
+    pk_backend_job_set_status(m_job, PK_STATUS_ENUM_QUERY);
+
+    // Package::ID is not the position of the package in the map, split
+    // the packages between the workers from a list of iterators
+    pkgCache *cache = m_cache->GetPkgCache();
+    vector<pkgCache::PkgIterator> packages;
+    packages.reserve(cache->HeaderP->PackageCount);
+    for (pkgCache::PkgIterator pkg = cache->PkgBegin(); !pkg.end(); ++pkg) {
+        packages.push_back(pkg);
+    }
+    const gsize packageCount = packages.size();
+
+    // Fill the lazily built state before the workers read it
+    if (filters != 0 && m_cache->versionAttributes().empty()) {
+        buildVersionAttributes();
+    }
+    APT::Configuration::getLanguages();
+
+    struct EmittedPackage {
+        pkgCache::VerIterator ver;
+        PkInfoEnum state;
+        string summary;
+    };
+
+    // pkgRecords keeps the parser state of the last lookup, give each
+    // worker its own
+    const guint workerCount = CLAMP(std::thread::hardware_concurrency(), 1, 8);
+    vector<std::unique_ptr<pkgRecords> > records;
+    vector<vector<EmittedPackage> > results(workerCount);
+    for (guint i = 0; i < workerCount; ++i) {
+        records.emplace_back(new pkgRecords(*cache));
+    }
+
+    vector<std::thread> workers;
+    for (guint i = 0; i < workerCount; ++i) {
+        const gsize first = packageCount * i / workerCount;
+        const gsize last = packageCount * (i + 1) / workerCount;
+        workers.emplace_back([&, i, first, last]() {
+            for (gsize n = first; n < last && !m_cancel; ++n) {
+                const pkgCache::PkgIterator &pkg = packages[n];
+
+                // Ignore packages that exist only due to dependencies.
+                if (pkg.VersionList().end() && pkg.ProvidesList().end()) {
+                    continue;
+                }
+
+                // Don't insert virtual packages as they don't have all kinds of info
+                const pkgCache::VerIterator &ver = m_cache->findVer(pkg);
+                if (ver.end() || !matchPackage(ver, filters)) {
+                    continue;
                 }
+
+                PkInfoEnum state = PK_INFO_ENUM_AVAILABLE;
+                if (pkg->CurrentState == pkgCache::State::Installed &&
+                        pkg.CurrentVer() == ver) {
+                    state = PK_INFO_ENUM_INSTALLED;
+                }
+
+                results[i].push_back({ ver,
+                                       state,
+                                       m_cache->getShortDescription(ver, *records[i]) });
             }
-        }
+        });
     }
-}
 
-PkgList AptIntf::getPackages()
-{
-    pk_backend_job_set_status(m_job, PK_STATUS_ENUM_QUERY);
+    for (std::thread &worker : workers) {
+        worker.join();
+    }
 
+    // Emit in the same order as emitPackages()
     PkgList output;
-    output.reserve(m_cache->GetPkgCache()->HeaderP->PackageCount);
-    for (pkgCache::PkgIterator pkg = m_cache->GetPkgCache()->PkgBegin(); !pkg.end(); ++pkg) {
-        if (m_cancel) {
-            break;
+    vector<const EmittedPackage*> emitted(cache->HeaderP->VersionCount, nullptr);
+    for (const vector<EmittedPackage> &result : results) {
+        for (const EmittedPackage &package : result) {
+            output.push_back(package.ver);
+            emitted[package.ver->ID] = &package;
         }
+    }
+    output.sort();
 
-        // Ignore packages that exist only due to dependencies.
-        if(pkg.VersionList().end() && pkg.ProvidesList().end()) {
-            continue;
-        }
+    // This filter looks at the archives directory, run it once
+    if (pk_bitfield_contain(filters, PK_FILTER_ENUM_DOWNLOADED)) {
+        output = filterDownloaded(output);
+    }
 
-        // Don't insert virtual packages as they don't have all kinds of info
-        const pkgCache::VerIterator &ver = m_cache->findVer(pkg);
-        if (ver.end() == false) {
-            output.push_back(ver);
+    for (const pkgCache::VerIterator &ver : output) {
+        if (m_cancel) {
+            break;
         }
+
+        // The ids are built here, in the reused buffer, rather than
+        // kept per package by the workers
+        const EmittedPackage *package = emitted[ver->ID];
+        pk_backend_job_package(m_job,
+                               package->state,
+                               m_cache->buildPackageId(ver, m_packageId),
+                               package->summary.c_str());
     }
-    return output;
 }
 
 PkgList AptIntf::getPackagesFromRepo(SourcesList::SourceRecord *&rec)
@@ -1092,13 +1510,10 @@ PkgList AptIntf::searchPackageName(const vector<string> &queries)
 {
     PkgList output;
 
-    for (pkgCache::PkgIterator pkg = m_cache->GetPkgCache()->PkgBegin(); !pkg.end(); ++pkg) {
-        if (m_cancel) {
-            break;
-        }
+    auto matchPackage = [&](const pkgCache::PkgIterator &pkg) {
         // Ignore packages that exist only due to dependencies.
         if (pkg.VersionList().end() && pkg.ProvidesList().end()) {
-            continue;
+            return;
         }
 
         if (matchesQueries(queries, pkg.Name())) {
@@ -1120,6 +1535,30 @@ PkgList AptIntf::searchPackageName(const vector<string> &queries)
                 }
             }
         }
+    };
+
+    // Only check the packages the index thinks might match
+    AptSearchIndex index;
+    vector<guint32> candidates;
+    pkgCache *cache = m_cache->GetPkgCache();
+    if (index.open(cache) && index.findNames(queries, candidates)) {
+        for (guint32 id : candidates) {
+            if (m_cancel) {
+                break;
+            }
+            const pkgCache::PkgIterator pkg = m_cache->findPackageById(id);
+            if (!pkg.end()) {
+                matchPackage(pkg);
+            }
+        }
+        return output;
+    }
+
+    for (pkgCache::PkgIterator pkg = cache->PkgBegin(); !pkg.end(); ++pkg) {
+        if (m_cancel) {
+            break;
+        }
+        matchPackage(pkg);
     }
     return output;
 }
@@ -1128,13 +1567,10 @@ PkgList AptIntf::searchPackageDetails(const vector<string> &queries)
 {
     PkgList output;
 
-    for (pkgCache::PkgIterator pkg = m_cache->GetPkgCache()->PkgBegin(); !pkg.end(); ++pkg) {
-        if (m_cancel) {
-            break;
-        }
+    auto matchPackage = [&](const pkgCache::PkgIterator &pkg) {
         // Ignore packages that exist only due to dependencies.
         if (pkg.VersionList().end() && pkg.ProvidesList().end()) {
-            continue;
+            return;
         }
 
         const pkgCache::VerIterator &ver = m_cache->findVer(pkg);
@@ -1160,15 +1596,37 @@ PkgList AptIntf::searchPackageDetails(const vector<string> &queries)
                 }
             }
         }
+    };
+
+    // Only read the descriptions of packages the index thinks might match
+    AptSearchIndex index;
+    vector<guint32> candidates;
+    pkgCache *cache = m_cache->GetPkgCache();
+    if (index.open(cache) && index.findDetails(queries, candidates)) {
+        for (guint32 id : candidates) {
+            if (m_cancel) {
+                break;
+            }
+            const pkgCache::PkgIterator pkg = m_cache->findPackageById(id);
+            if (!pkg.end()) {
+                matchPackage(pkg);
+            }
+        }
+        return output;
+    }
+
+    for (pkgCache::PkgIterator pkg = cache->PkgBegin(); !pkg.end(); ++pkg) {
+        if (m_cancel) {
+            break;
+        }
+        matchPackage(pkg);
     }
     return output;
 }
 
 // used to return files it reads, using the info from the files in /var/lib/dpkg/info/
-PkgList AptIntf::searchPackageFiles(gchar **values)
+void AptIntf::searchListFiles(gchar **values, vector<string> &packages)
 {
-    PkgList output;
-    vector<string> packages;
     string search;
     regex_t re;
 
@@ -1194,15 +1652,16 @@ PkgList AptIntf::searchPackageFiles(gchar **values)
 
     if(regcomp(&re, search.c_str(), REG_NOSUB) != 0) {
         g_debug("Regex compilation error");
-        return output;
+        return;
     }
 
+    const string infoDir = utilDpkgInfoDir();
     DIR *dp;
     struct dirent *dirp;
-    if (!(dp = opendir("/var/lib/dpkg/info/"))) {
-        g_debug ("Error opening /var/lib/dpkg/info/\n");
+    if (!(dp = opendir(infoDir.c_str()))) {
+        g_debug ("Error opening %s", infoDir.c_str());
         regfree(&re);
-        return output;
+        return;
     }
 
     string line;
@@ -1213,7 +1672,7 @@ PkgList AptIntf::searchPackageFiles(gchar **values)
 
         if (ends_with(dirp->d_name, ".list")) {
             string file(dirp->d_name);
-            string f = "/var/lib/dpkg/info/" + file;
+            string f = infoDir + file;
             ifstream in(f.c_str());
             if (!in != 0) {
                 continue;
@@ -1230,6 +1689,19 @@ PkgList AptIntf::searchPackageFiles(gchar **values)
     }
     closedir(dp);
     regfree(&re);
+}
+
+PkgList AptIntf::searchPackageFiles(gchar **values)
+{
+    PkgList output;
+    vector<string> packages;
+
+    // Look the files up in the index, updating it first if dpkg
+    // installed or removed packages since it was written
+    AptFileIndex index;
+    if (!(index.open() || index.update()) || !index.find(values, packages)) {
+        searchListFiles(values, packages);
+    }
 
     // Resolve the package names now
     for (const string &name : packages) {
@@ -1270,6 +1742,16 @@ PkgList AptIntf::getUpdates(PkgList &blocked, PkgList &downgrades)
 {
     PkgList updates;
 
+    // The resolver gives the same answer as long as the cache, the dpkg
+    // status and the preferences are unchanged. Only trust the stamp if
+    // it is still the one the cache was opened with.
+    const string stamp = AptCacheFile::sourcesStamp();
+    const bool snapshot = m_cacheReusable && stamp == m_cacheStamp;
+    if (snapshot && AptUpdateSnapshot::load(*m_cache, stamp, updates, blocked, downgrades)) {
+        g_debug("Using the saved update snapshot");
+        return updates;
+    }
+
     if (m_cache->DistUpgrade() == false) {
         m_cache->ShowBroken(false);
         g_debug("Internal error, DistUpgrade broke stuff");
@@ -1304,6 +1786,10 @@ PkgList AptIntf::getUpdates(PkgList &blocked, PkgList &downgrades)
         }
     }
 
+    if (snapshot && !m_cancel) {
+        AptUpdateSnapshot::save(*m_cache, stamp, updates, blocked, downgrades);
+    }
+
     return updates;
 }
 
@@ -1370,18 +1856,22 @@ bool AptIntf::isApplication(const pkgCache::VerIterator &ver)
     gchar *fileName;
     string line;
 
+    const string infoDir = utilDpkgInfoDir();
     if (m_isMultiArch) {
-        fileName = g_strdup_printf("/var/lib/dpkg/info/%s:%s.list",
+        fileName = g_strdup_printf("%s%s:%s.list",
+                                   infoDir.c_str(),
                                    ver.ParentPkg().Name(),
                                    ver.Arch());
         if (!FileExists(fileName)) {
             g_free(fileName);
             // if the file was not found try without the arch field
-            fileName = g_strdup_printf("/var/lib/dpkg/info/%s.list",
+            fileName = g_strdup_printf("%s%s.list",
+                                       infoDir.c_str(),
                                        ver.ParentPkg().Name());
         }
     } else {
-        fileName = g_strdup_printf("/var/lib/dpkg/info/%s.list",
+        fileName = g_strdup_printf("%s%s.list",
+                                   infoDir.c_str(),
                                    ver.ParentPkg().Name());
     }
 
@@ -1414,21 +1904,22 @@ void AptIntf::emitPackageFiles(const gchar *pi)
 
     parts = pk_package_id_split(pi);
 
+    const string infoDir = utilDpkgInfoDir();
     string fName;
     if (m_isMultiArch) {
-        fName = "/var/lib/dpkg/info/" +
+        fName = infoDir +
                 string(parts[PK_PACKAGE_ID_NAME]) +
                 ":" +
                 string(parts[PK_PACKAGE_ID_ARCH]) +
                 ".list";
         if (!FileExists(fName)) {
             // if the file was not found try without the arch field
-            fName = "/var/lib/dpkg/info/" +
+            fName = infoDir +
                     string(parts[PK_PACKAGE_ID_NAME]) +
                     ".list";
         }
     } else {
-        fName = "/var/lib/dpkg/info/" +
+        fName = infoDir +
                 string(parts[PK_PACKAGE_ID_NAME]) +
                 ".list";
     }
@@ -1482,17 +1973,24 @@ void AptIntf::emitPackageFilesLocal(const gchar *file)
 /**
   * Check if package is officially supported by the current distribution
   */
-bool AptIntf::packageIsSupported(const pkgCache::VerIterator &verIter, string component)
+guint8 AptIntf::versionAttributes(const pkgCache::VerIterator &ver)
 {
-    string origin;
-    if (!verIter.end()) {
-        pkgCache::VerFileIterator vf = verIter.FileList();
-        origin = vf.File().Origin() == NULL ? "" : vf.File().Origin();
+    const vector<guint8> &verAttributes = m_cache->versionAttributes();
+    if (verAttributes.empty()) {
+        buildVersionAttributes();
     }
 
-    if (component.empty()) {
-        component = "main";
+    if (ver->ID >= verAttributes.size()) {
+        return 0;
     }
+    return verAttributes[ver->ID];
+}
+
+void AptIntf::buildVersionAttributes()
+{
+    pkgCache *cache = m_cache->GetPkgCache();
+    vector<guint8> &verAttributes = m_cache->versionAttributes();
+    verAttributes.assign(cache->HeaderP->VersionCount, 0);
 
     // Get a fetcher
     AcqPackageKitStatus Stat(this, m_job);
@@ -1502,16 +2000,79 @@ bool AptIntf::packageIsSupported(const pkgCache::VerIterator &verIter, string co
     PkBitfield flags = pk_backend_job_get_transaction_flags(m_job);
     bool trusted = checkTrusted(fetcher, flags);
 
-    if ((origin.compare("Debian") == 0) || (origin.compare("Ubuntu") == 0))  {
-        if ((component.compare("main") == 0 ||
-             component.compare("restricted") == 0 ||
-             component.compare("unstable") == 0 ||
-             component.compare("testing") == 0) && trusted) {
-            return true;
+    // Installed packages shipping a .desktop file are applications,
+    // look them up at once in the file index if we have one
+    std::set<string> applications;
+    AptFileIndex index;
+    gchar *desktopFiles[] = { (gchar *) ".desktop", NULL };
+    vector<string> owners;
+    m_cache->setApplicationsIndexed((index.open() || index.update()) &&
+                                    index.find(desktopFiles, owners));
+    applications.insert(owners.begin(), owners.end());
+
+    const string nativeArch = _config->Find("APT::Architecture");
+    for (pkgCache::PkgIterator pkg = cache->PkgBegin(); !pkg.end(); ++pkg) {
+        const string pkgName = pkg.Name();
+        const bool devName = ends_with(pkgName, "-dev") || ends_with(pkgName, "-dbg");
+
+        for (pkgCache::VerIterator ver = pkg.VersionList(); !ver.end(); ++ver) {
+            guint8 attributes = 0;
+
+            if (pkg->CurrentState == pkgCache::State::Installed && pkg.CurrentVer() == ver) {
+                attributes |= VER_INSTALLED;
+
+                const string listName = m_isMultiArch ? pkgName + ":" + ver.Arch() : pkgName;
+                if (applications.count(listName) || applications.count(pkgName)) {
+                    attributes |= VER_APPLICATION;
+                }
+            }
+
+            if (strcmp(ver.Arch(), "all") == 0 || nativeArch.compare(ver.Arch()) == 0) {
+                attributes |= VER_NATIVE_ARCH;
+            }
+
+            std::string str = ver.Section() == NULL ? "" : ver.Section();
+            std::string section, component;
+
+            size_t found;
+            found = str.find_last_of("/");
+            section = str.substr(found + 1);
+            if(found == str.npos) {
+                component = "main";
+            } else {
+                component = str.substr(0, found);
+            }
+
+            if (devName || section == "devel" || section == "libdevel") {
+                attributes |= VER_DEVEL;
+            }
+
+            if (section == "x11" || section == "gnome" ||
+                    section == "kde" || section == "graphics") {
+                attributes |= VER_GUI;
+            }
+
+            if (component == "main" || component == "universe") {
+                attributes |= VER_FREE;
+            }
+
+            pkgCache::VerFileIterator vf = ver.FileList();
+            const char *origin = vf.end() ? NULL : vf.File().Origin();
+            if (component.empty()) {
+                component = "main";
+            }
+            if (origin != NULL &&
+                    (strcmp(origin, "Debian") == 0 || strcmp(origin, "Ubuntu") == 0) &&
+                    (component == "main" ||
+                     component == "restricted" ||
+                     component == "unstable" ||
+                     component == "testing") && trusted) {
+                attributes |= VER_SUPPORTED;
+            }
+
+            verAttributes[ver->ID] = attributes;
         }
     }
-
-    return false;
 }
 
 bool AptIntf::checkTrusted(pkgAcquire &fetcher, PkBitfield flags)
@@ -1661,42 +2222,242 @@ pkgCache::VerIterator AptIntf::findTransactionPackage(const std::string &name)
 
 void AptIntf::updateInterface(int fd, int writeFd)
 {
-    char buf[2];
-    static char line[1024] = "";
+    char buf[4096];
+    ssize_t len;
 
-    while (1) {
-        // This algorithm should be improved (it's the same as the rpm one ;)
-        int len = read(fd, buf, 1);
+    // Read whatever dpkg wrote so far, the last line may be incomplete
+    while ((len = read(fd, buf, sizeof(buf))) > 0) {
+        // update the time we last saw some action
+        m_lastTermAction = time(NULL);
 
-        // nothing was read
-        if(len < 1) {
-            break;
+        m_statusLine.append(buf, len);
+        size_t start = 0;
+        size_t end;
+        while ((end = m_statusLine.find('\n', start)) != string::npos) {
+            m_statusLine[end] = '\0';
+            handleStatusLine(&m_statusLine[start], writeFd);
+            start = end + 1;
         }
+        m_statusLine.erase(0, start);
+    }
 
-        // update the time we last saw some action
+    time_t now = time(NULL);
+
+    if(!m_startCounting) {
+        // wait until we get the first message from apt
+        m_lastTermAction = now;
+    }
+
+    if ((now - m_lastTermAction) > m_terminalTimeout) {
+        // get some debug info
+        g_warning("no statusfd changes/content updates in terminal for %i"
+                  " seconds",m_terminalTimeout);
         m_lastTermAction = time(NULL);
+    }
+}
 
-        if( buf[0] == '\n') {
-            if (m_cancel) {
-                kill(m_child_pid, SIGTERM);
-            }
-            //cout << "got line: " << line << endl;
+void AptIntf::handleStatusLine(const gchar *line, int writeFd)
+{
+    if (m_cancel) {
+        kill(m_child_pid, SIGTERM);
+    }
+    //cout << "got line: " << line << endl;
 
-            gchar **split  = g_strsplit(line, ":",5);
-            gchar *status  = g_strstrip(split[0]);
-            gchar *pkg     = g_strstrip(split[1]);
-            gchar *percent = g_strstrip(split[2]);
-            gchar *str     = g_strdup(g_strstrip(split[3]));
+    gchar **split  = g_strsplit(line, ":",5);
+    gchar *status  = g_strstrip(split[0]);
+    gchar *pkg     = g_strstrip(split[1]);
+    gchar *percent = g_strstrip(split[2]);
+    gchar *str     = g_strdup(g_strstrip(split[3]));
 
-            // major problem here, we got unexpected input. should _never_ happen
-            if(!(pkg && status)) {
-                continue;
-            }
+    // major problem here, we got unexpected input. should _never_ happen
+    if(!(pkg && status)) {
+        g_strfreev(split);
+        g_free(str);
+        return;
+    }
+
+    // Since PackageKit doesn't emulate finished anymore
+    // we need to manually do it here, as at this point
+    // dpkg doesn't process two packages at the same time
+    if (!m_lastPackage.empty() && m_lastPackage.compare(pkg) != 0) {
+        const pkgCache::VerIterator &ver = findTransactionPackage(m_lastPackage);
+        if (!ver.end()) {
+            emitPackage(ver, PK_INFO_ENUM_FINISHED);
+        }
+        m_lastSubProgress = 0;
+    }
+
+    // first check for errors and conf-file prompts
+    if (strstr(status, "pmerror") != NULL) {
+        // error from dpkg
+        pk_backend_job_error_code(m_job,
+                                  PK_ERROR_ENUM_PACKAGE_FAILED_TO_INSTALL,
+                                  "Error while installing package: %s",
+                                  str);
+    } else if (strstr(status, "pmconffile") != NULL) {
+        // conffile-request from dpkg, needs to be parsed different
+        int i=0;
+        int count=0;
+        string orig_file, new_file;
+
+        // go to first ' and read until the end
+        for(;str[i] != '\'' || str[i] == 0; i++)
+            /*nothing*/
+            ;
+        i++;
+        for(;str[i] != '\'' || str[i] == 0; i++)
+            orig_file.append(1, str[i]);
+        i++;
+
+        // same for second ' and read until the end
+        for(;str[i] != '\'' || str[i] == 0; i++)
+            /*nothing*/
+            ;
+        i++;
+        for(;str[i] != '\'' || str[i] == 0; i++)
+            new_file.append(1, str[i]);
+        i++;
+
+        gchar *filename;
+        filename = g_build_filename(DATADIR, "PackageKit", "helpers", "aptcc", "pkconffile", NULL);
+        gchar **argv;
+        gchar **envp;
+        GError *error = NULL;
+        argv = (gchar **) g_malloc(5 * sizeof(gchar *));
+        argv[0] = filename;
+        argv[1] = g_strdup(m_lastPackage.c_str());
+        argv[2] = g_strdup(orig_file.c_str());
+        argv[3] = g_strdup(new_file.c_str());
+        argv[4] = NULL;
 
-            // Since PackageKit doesn't emulate finished anymore
-            // we need to manually do it here, as at this point
-            // dpkg doesn't process two packages at the same time
-            if (!m_lastPackage.empty() && m_lastPackage.compare(pkg) != 0) {
+        const gchar *socket = pk_backend_job_get_frontend_socket(m_job);
+        if ((m_interactive) && (socket != NULL)) {
+            envp = (gchar **) g_malloc(3 * sizeof(gchar *));
+            envp[0] = g_strdup("DEBIAN_FRONTEND=passthrough");
+            envp[1] = g_strdup_printf("DEBCONF_PIPE=%s", socket);
+            envp[2] = NULL;
+        } else {
+            // we don't have a socket set or are non-interactive. Use the noninteractive frontend.
+            envp = (gchar **) g_malloc(2 * sizeof(gchar *));
+            envp[0] = g_strdup("DEBIAN_FRONTEND=noninteractive");
+            envp[1] = NULL;
+        }
+
+        gboolean ret;
+        gint exitStatus;
+        ret = g_spawn_sync(NULL, // working dir
+                           argv, // argv
+                           envp, // envp
+                           G_SPAWN_LEAVE_DESCRIPTORS_OPEN,
+                           NULL, // child_setup
+                           NULL, // user_data
+                           NULL, // standard_output
+                           NULL, // standard_error
+                           &exitStatus,
+                           &error);
+
+        int exit_code = WEXITSTATUS(exitStatus);
+        cout << filename << " " << exit_code << " ret: "<< ret << endl;
+
+        g_strfreev(argv);
+        g_strfreev(envp);
+
+        if (exit_code == 10) {
+            // 1 means the user wants the package config
+            if (write(writeFd, "Y\n", 2) != 2) {
+                // TODO we need a DPKG patch to use debconf
+                g_debug("Failed to write");
+            }
+        } else if (exit_code == 20) {
+            // 2 means the user wants to keep the current config
+            if (write(writeFd, "N\n", 2) != 2) {
+                // TODO we need a DPKG patch to use debconf
+                g_debug("Failed to write");
+            }
+        } else {
+            // either the user didn't choose an option or the front end failed'
+            //                     pk_backend_job_message(m_job,
+            //                                            PK_MESSAGE_ENUM_CONFIG_FILES_CHANGED,
+            //                                            "The configuration file '%s' "
+            //                                            "(modified by you or a script) "
+            //                                            "has a newer version '%s'.\n"
+            //                                            "Please verify your changes and update it manually.",
+            //                                            orig_file.c_str(),
+            //                                            new_file.c_str());
+            // fall back to keep the current config file
+            if (write(writeFd, "N\n", 2) != 2) {
+                // TODO we need a DPKG patch to use debconf
+                g_debug("Failed to write");
+            }
+        }
+    } else if (strstr(status, "pmstatus") != NULL) {
+        // INSTALL & UPDATE
+        // - Running dpkg
+        // loops ALL
+        // -  0 Installing pkg (sometimes this is skiped)
+        // - 25 Preparing pkg
+        // - 50 Unpacking pkg
+        // - 75 Preparing to configure pkg
+        //   ** Some pkgs have
+        //   - Running post-installation
+        //   - Running dpkg
+        // reloops all
+        // -   0 Configuring pkg
+        // - +25 Configuring pkg (SOMETIMES)
+        // - 100 Installed pkg
+        // after all
+        // - Running post-installation
+
+        // REMOVE
+        // - Running dpkg
+        // loops
+        // - 25  Removing pkg
+        // - 50  Preparing for removal of pkg
+        // - 75  Removing pkg
+        // - 100 Removed pkg
+        // after all
+        // - Running post-installation
+
+        // Let's start parsing the status:
+        if (starts_with(str, "Preparing to configure")) {
+            // Preparing to Install/configure
+            // cout << "Found Preparing to configure! " << line << endl;
+            // The next item might be Configuring so better it be 100
+            m_lastSubProgress = 100;
+            const pkgCache::VerIterator &ver = findTransactionPackage(pkg);
+            if (!ver.end()) {
+                emitPackage(ver, PK_INFO_ENUM_PREPARING);
+                emitPackageProgress(ver, PK_STATUS_ENUM_SETUP, 75);
+            }
+        } else if (starts_with(str, "Preparing for removal")) {
+            // Preparing to Install/configure
+            // cout << "Found Preparing for removal! " << line << endl;
+            m_lastSubProgress = 50;
+            const pkgCache::VerIterator &ver = findTransactionPackage(pkg);
+            if (!ver.end()) {
+                emitPackage(ver, PK_INFO_ENUM_REMOVING);
+                emitPackageProgress(ver, PK_STATUS_ENUM_SETUP, m_lastSubProgress);
+            }
+        } else if (starts_with(str, "Preparing")) {
+            // Preparing to Install/configure
+            // cout << "Found Preparing! " << line << endl;
+            const pkgCache::VerIterator &ver = findTransactionPackage(pkg);
+            if (!ver.end()) {
+                emitPackage(ver, PK_INFO_ENUM_PREPARING);
+                emitPackageProgress(ver, PK_STATUS_ENUM_SETUP, 25);
+            }
+        } else if (starts_with(str, "Unpacking")) {
+            // cout << "Found Unpacking! " << line << endl;
+            const pkgCache::VerIterator &ver = findTransactionPackage(pkg);
+            if (!ver.end()) {
+                emitPackage(ver, PK_INFO_ENUM_DECOMPRESSING);
+                emitPackageProgress(ver, PK_STATUS_ENUM_INSTALL, 50);
+            }
+        } else if (starts_with(str, "Configuring")) {
+            // Installing Package
+            // cout << "Found Configuring! " << line << endl;
+            if (m_lastSubProgress >= 100 && !m_lastPackage.empty()) {
+                // cout << "FINISH the last package: " << m_lastPackage << endl;
                 const pkgCache::VerIterator &ver = findTransactionPackage(m_lastPackage);
                 if (!ver.end()) {
                     emitPackage(ver, PK_INFO_ENUM_FINISHED);
@@ -1704,279 +2465,77 @@ void AptIntf::updateInterface(int fd, int writeFd)
                 m_lastSubProgress = 0;
             }
 
-            // first check for errors and conf-file prompts
-            if (strstr(status, "pmerror") != NULL) {
-                // error from dpkg
-                pk_backend_job_error_code(m_job,
-                                          PK_ERROR_ENUM_PACKAGE_FAILED_TO_INSTALL,
-                                          "Error while installing package: %s",
-                                          str);
-            } else if (strstr(status, "pmconffile") != NULL) {
-                // conffile-request from dpkg, needs to be parsed different
-                int i=0;
-                int count=0;
-                string orig_file, new_file;
-
-                // go to first ' and read until the end
-                for(;str[i] != '\'' || str[i] == 0; i++)
-                    /*nothing*/
-                    ;
-                i++;
-                for(;str[i] != '\'' || str[i] == 0; i++)
-                    orig_file.append(1, str[i]);
-                i++;
-
-                // same for second ' and read until the end
-                for(;str[i] != '\'' || str[i] == 0; i++)
-                    /*nothing*/
-                    ;
-                i++;
-                for(;str[i] != '\'' || str[i] == 0; i++)
-                    new_file.append(1, str[i]);
-                i++;
-
-                gchar *filename;
-                filename = g_build_filename(DATADIR, "PackageKit", "helpers", "aptcc", "pkconffile", NULL);
-                gchar **argv;
-                gchar **envp;
-                GError *error = NULL;
-                argv = (gchar **) g_malloc(5 * sizeof(gchar *));
-                argv[0] = filename;
-                argv[1] = g_strdup(m_lastPackage.c_str());
-                argv[2] = g_strdup(orig_file.c_str());
-                argv[3] = g_strdup(new_file.c_str());
-                argv[4] = NULL;
-
-                const gchar *socket = pk_backend_job_get_frontend_socket(m_job);
-                if ((m_interactive) && (socket != NULL)) {
-                    envp = (gchar **) g_malloc(3 * sizeof(gchar *));
-                    envp[0] = g_strdup("DEBIAN_FRONTEND=passthrough");
-                    envp[1] = g_strdup_printf("DEBCONF_PIPE=%s", socket);
-                    envp[2] = NULL;
-                } else {
-                    // we don't have a socket set or are non-interactive. Use the noninteractive frontend.
-                    envp = (gchar **) g_malloc(2 * sizeof(gchar *));
-                    envp[0] = g_strdup("DEBIAN_FRONTEND=noninteractive");
-                    envp[1] = NULL;
-                }
-
-                gboolean ret;
-                gint exitStatus;
-                ret = g_spawn_sync(NULL, // working dir
-                                   argv, // argv
-                                   envp, // envp
-                                   G_SPAWN_LEAVE_DESCRIPTORS_OPEN,
-                                   NULL, // child_setup
-                                   NULL, // user_data
-                                   NULL, // standard_output
-                                   NULL, // standard_error
-                                   &exitStatus,
-                                   &error);
-
-                int exit_code = WEXITSTATUS(exitStatus);
-                cout << filename << " " << exit_code << " ret: "<< ret << endl;
-
-                g_strfreev(argv);
-                g_strfreev(envp);
-
-                if (exit_code == 10) {
-                    // 1 means the user wants the package config
-                    if (write(writeFd, "Y\n", 2) != 2) {
-                        // TODO we need a DPKG patch to use debconf
-                        g_debug("Failed to write");
-                    }
-                } else if (exit_code == 20) {
-                    // 2 means the user wants to keep the current config
-                    if (write(writeFd, "N\n", 2) != 2) {
-                        // TODO we need a DPKG patch to use debconf
-                        g_debug("Failed to write");
-                    }
-                } else {
-                    // either the user didn't choose an option or the front end failed'
-                    //                     pk_backend_job_message(m_job,
-                    //                                            PK_MESSAGE_ENUM_CONFIG_FILES_CHANGED,
-                    //                                            "The configuration file '%s' "
-                    //                                            "(modified by you or a script) "
-                    //                                            "has a newer version '%s'.\n"
-                    //                                            "Please verify your changes and update it manually.",
-                    //                                            orig_file.c_str(),
-                    //                                            new_file.c_str());
-                    // fall back to keep the current config file
-                    if (write(writeFd, "N\n", 2) != 2) {
-                        // TODO we need a DPKG patch to use debconf
-                        g_debug("Failed to write");
-                    }
-                }
-            } else if (strstr(status, "pmstatus") != NULL) {
-                // INSTALL & UPDATE
-                // - Running dpkg
-                // loops ALL
-                // -  0 Installing pkg (sometimes this is skiped)
-                // - 25 Preparing pkg
-                // - 50 Unpacking pkg
-                // - 75 Preparing to configure pkg
-                //   ** Some pkgs have
-                //   - Running post-installation
-                //   - Running dpkg
-                // reloops all
-                // -   0 Configuring pkg
-                // - +25 Configuring pkg (SOMETIMES)
-                // - 100 Installed pkg
-                // after all
-                // - Running post-installation
-
-                // REMOVE
-                // - Running dpkg
-                // loops
-                // - 25  Removing pkg
-                // - 50  Preparing for removal of pkg
-                // - 75  Removing pkg
-                // - 100 Removed pkg
-                // after all
-                // - Running post-installation
-
-                // Let's start parsing the status:
-                if (starts_with(str, "Preparing to configure")) {
-                    // Preparing to Install/configure
-                    // cout << "Found Preparing to configure! " << line << endl;
-                    // The next item might be Configuring so better it be 100
-                    m_lastSubProgress = 100;
-                    const pkgCache::VerIterator &ver = findTransactionPackage(pkg);
-                    if (!ver.end()) {
-                        emitPackage(ver, PK_INFO_ENUM_PREPARING);
-                        emitPackageProgress(ver, PK_STATUS_ENUM_SETUP, 75);
-                    }
-                } else if (starts_with(str, "Preparing for removal")) {
-                    // Preparing to Install/configure
-                    // cout << "Found Preparing for removal! " << line << endl;
-                    m_lastSubProgress = 50;
-                    const pkgCache::VerIterator &ver = findTransactionPackage(pkg);
-                    if (!ver.end()) {
-                        emitPackage(ver, PK_INFO_ENUM_REMOVING);
-                        emitPackageProgress(ver, PK_STATUS_ENUM_SETUP, m_lastSubProgress);
-                    }
-                } else if (starts_with(str, "Preparing")) {
-                    // Preparing to Install/configure
-                    // cout << "Found Preparing! " << line << endl;
-                    const pkgCache::VerIterator &ver = findTransactionPackage(pkg);
-                    if (!ver.end()) {
-                        emitPackage(ver, PK_INFO_ENUM_PREPARING);
-                        emitPackageProgress(ver, PK_STATUS_ENUM_SETUP, 25);
-                    }
-                } else if (starts_with(str, "Unpacking")) {
-                    // cout << "Found Unpacking! " << line << endl;
-                    const pkgCache::VerIterator &ver = findTransactionPackage(pkg);
-                    if (!ver.end()) {
-                        emitPackage(ver, PK_INFO_ENUM_DECOMPRESSING);
-                        emitPackageProgress(ver, PK_STATUS_ENUM_INSTALL, 50);
-                    }
-                } else if (starts_with(str, "Configuring")) {
-                    // Installing Package
-                    // cout << "Found Configuring! " << line << endl;
-                    if (m_lastSubProgress >= 100 && !m_lastPackage.empty()) {
-                        // cout << "FINISH the last package: " << m_lastPackage << endl;
-                        const pkgCache::VerIterator &ver = findTransactionPackage(m_lastPackage);
-                        if (!ver.end()) {
-                            emitPackage(ver, PK_INFO_ENUM_FINISHED);
-                        }
-                        m_lastSubProgress = 0;
-                    }
-
-                    const pkgCache::VerIterator &ver = findTransactionPackage(pkg);
-                    if (!ver.end()) {
-                        emitPackage(ver, PK_INFO_ENUM_INSTALLING);
-                        emitPackageProgress(ver, PK_STATUS_ENUM_INSTALL, m_lastSubProgress);
-                    }
-                    m_lastSubProgress += 25;
-                } else if (starts_with(str, "Running dpkg")) {
-                    // cout << "Found Running dpkg! " << line << endl;
-                } else if (starts_with(str, "Running")) {
-                    // cout << "Found Running! " << line << endl;
-                    pk_backend_job_set_status (m_job, PK_STATUS_ENUM_COMMIT);
-                } else if (starts_with(str, "Installing")) {
-                    // cout << "Found Installing! " << line << endl;
-                    // FINISH the last package
-                    if (!m_lastPackage.empty()) {
-                        // cout << "FINISH the last package: " << m_lastPackage << endl;
-                        const pkgCache::VerIterator &ver = findTransactionPackage(m_lastPackage);
-                        if (!ver.end()) {
-                            emitPackage(ver, PK_INFO_ENUM_FINISHED);
-                        }
-                    }
-                    m_lastSubProgress = 0;
-                    const pkgCache::VerIterator &ver = findTransactionPackage(pkg);
-                    if (!ver.end()) {
-                        emitPackage(ver, PK_INFO_ENUM_INSTALLING);
-                        emitPackageProgress(ver, PK_STATUS_ENUM_INSTALL, m_lastSubProgress);
-                    }
-                } else if (starts_with(str, "Removing")) {
-                    // cout << "Found Removing! " << line << endl;
-                    if (m_lastSubProgress >= 100 && !m_lastPackage.empty()) {
-                        // cout << "FINISH the last package: " << m_lastPackage << endl;
-                        const pkgCache::VerIterator &ver = findTransactionPackage(m_lastPackage);
-                        if (!ver.end()) {
-                            emitPackage(ver, PK_INFO_ENUM_FINISHED);
-                        }
-                    }
-                    m_lastSubProgress += 25;
-
-                    const pkgCache::VerIterator &ver = findTransactionPackage(pkg);
-                    if (!ver.end()) {
-                        emitPackage(ver, PK_INFO_ENUM_REMOVING);
-                        emitPackageProgress(ver, PK_STATUS_ENUM_REMOVE, m_lastSubProgress);
-                    }
-                } else if (starts_with(str, "Installed") ||
-                           starts_with(str, "Removed")) {
-                    // cout << "Found FINISHED! " << line << endl;
-                    m_lastSubProgress = 100;
-                    const pkgCache::VerIterator &ver = findTransactionPackage(pkg);
-                    if (!ver.end()) {
-                        emitPackage(ver, PK_INFO_ENUM_FINISHED);
-                        //                         emitPackageProgress(ver, m_lastSubProgress);
-                    }
-                } else {
-                    cout << ">>>Unmaped value<<< :" << line << endl;
+            const pkgCache::VerIterator &ver = findTransactionPackage(pkg);
+            if (!ver.end()) {
+                emitPackage(ver, PK_INFO_ENUM_INSTALLING);
+                emitPackageProgress(ver, PK_STATUS_ENUM_INSTALL, m_lastSubProgress);
+            }
+            m_lastSubProgress += 25;
+        } else if (starts_with(str, "Running dpkg")) {
+            // cout << "Found Running dpkg! " << line << endl;
+        } else if (starts_with(str, "Running")) {
+            // cout << "Found Running! " << line << endl;
+            pk_backend_job_set_status (m_job, PK_STATUS_ENUM_COMMIT);
+        } else if (starts_with(str, "Installing")) {
+            // cout << "Found Installing! " << line << endl;
+            // FINISH the last package
+            if (!m_lastPackage.empty()) {
+                // cout << "FINISH the last package: " << m_lastPackage << endl;
+                const pkgCache::VerIterator &ver = findTransactionPackage(m_lastPackage);
+                if (!ver.end()) {
+                    emitPackage(ver, PK_INFO_ENUM_FINISHED);
                 }
-
-                if (!starts_with(str, "Running")) {
-                    m_lastPackage = pkg;
+            }
+            m_lastSubProgress = 0;
+            const pkgCache::VerIterator &ver = findTransactionPackage(pkg);
+            if (!ver.end()) {
+                emitPackage(ver, PK_INFO_ENUM_INSTALLING);
+                emitPackageProgress(ver, PK_STATUS_ENUM_INSTALL, m_lastSubProgress);
+            }
+        } else if (starts_with(str, "Removing")) {
+            // cout << "Found Removing! " << line << endl;
+            if (m_lastSubProgress >= 100 && !m_lastPackage.empty()) {
+                // cout << "FINISH the last package: " << m_lastPackage << endl;
+                const pkgCache::VerIterator &ver = findTransactionPackage(m_lastPackage);
+                if (!ver.end()) {
+                    emitPackage(ver, PK_INFO_ENUM_FINISHED);
                 }
-                m_startCounting = true;
-            } else {
-                m_startCounting = true;
             }
+            m_lastSubProgress += 25;
 
-            int val = atoi(percent);
-            //cout << "progress: " << val << endl;
-            pk_backend_job_set_percentage(m_job, val);
-
-            // clean-up
-            g_strfreev(split);
-            g_free(str);
-            line[0] = 0;
+            const pkgCache::VerIterator &ver = findTransactionPackage(pkg);
+            if (!ver.end()) {
+                emitPackage(ver, PK_INFO_ENUM_REMOVING);
+                emitPackageProgress(ver, PK_STATUS_ENUM_REMOVE, m_lastSubProgress);
+            }
+        } else if (starts_with(str, "Installed") ||
+                   starts_with(str, "Removed")) {
+            // cout << "Found FINISHED! " << line << endl;
+            m_lastSubProgress = 100;
+            const pkgCache::VerIterator &ver = findTransactionPackage(pkg);
+            if (!ver.end()) {
+                emitPackage(ver, PK_INFO_ENUM_FINISHED);
+                //                         emitPackageProgress(ver, m_lastSubProgress);
+            }
         } else {
-            buf[1] = 0;
-            strcat(line, buf);
+            cout << ">>>Unmaped value<<< :" << line << endl;
         }
-    }
-
-    time_t now = time(NULL);
 
-    if(!m_startCounting) {
-        usleep(100000);
-        // wait until we get the first message from apt
-        m_lastTermAction = now;
+        if (!starts_with(str, "Running")) {
+            m_lastPackage = pkg;
+        }
+        m_startCounting = true;
+    } else {
+        m_startCounting = true;
     }
 
-    if ((now - m_lastTermAction) > m_terminalTimeout) {
-        // get some debug info
-        g_warning("no statusfd changes/content updates in terminal for %i"
-                  " seconds",m_terminalTimeout);
-        m_lastTermAction = time(NULL);
-    }
+    int val = atoi(percent);
+    //cout << "progress: " << val << endl;
+    pk_backend_job_set_percentage(m_job, val);
 
-    // sleep for a while to don't obcess over it
-    usleep(5000);
+    // clean-up
+    g_strfreev(split);
+    g_free(str);
 }
 
 PkgList AptIntf::resolvePackageIds(gchar **package_ids, PkBitfield filters)
@@ -2090,6 +2649,39 @@ void AptIntf::refreshCache()
         // TODO this shouldn't
         show_errors(m_job, PK_ERROR_ENUM_GPG_FAILURE);
     }
+
+    if (_error->PendingError() == false) {
+        buildIndexes();
+    }
+}
+
+void AptIntf::buildIndexes()
+{
+    // BuildCaches() does nothing while a cache is loaded, reopen it
+    // so we index the freshly generated pkgcache.bin
+    m_cache->Close();
+    if (m_cache->Open() == false) {
+        _error->Discard();
+        return;
+    }
+
+    if (!AptSearchIndex::build(*m_cache)) {
+        g_debug("Failed to build the search index");
+    }
+
+    if (!AptSummaryIndex::build(*m_cache)) {
+        g_debug("Failed to build the summary index");
+    }
+
+    if (!AptSonameIndex::build()) {
+        g_debug("Failed to build the soname index");
+    }
+
+    if (!AptGstIndex::build(*m_cache)) {
+        g_debug("Failed to build the gstreamer index");
+    }
+
+    AptChangelog::prune();
 }
 
 void AptIntf::markAutoInstalled(const PkgList &pkgs)
@@ -2460,6 +3052,9 @@ bool AptIntf::installPackages(PkBitfield flags, bool autoremove)
     }
 
     cout << "PARENT process running..." << endl;
+    // only the child writes to the status pipe
+    close(readFromChildFD[1]);
+
     // make it nonblocking, verry important otherwise
     // when the child finish we stay stuck.
     fcntl(readFromChildFD[0], F_SETFL, O_NONBLOCK);
@@ -2468,18 +3063,69 @@ bool AptIntf::installPackages(PkBitfield flags, bool autoremove)
     // init the timer
     m_lastTermAction = time(NULL);
     m_startCounting = false;
+    m_statusLine.clear();
+
+    // Sleep until dpkg writes something, waking up once in a while to
+    // check if the child died and for the terminal timeout
+    struct pollfd fds[2];
+    fds[0].fd = readFromChildFD[0];
+    fds[0].events = POLLIN;
+    fds[1].fd = pty_master;
+    fds[1].events = POLLIN;
+
+    struct timespec cpuStart;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpuStart);
 
-    // Check if the child died
     int ret;
-    char masterbuf[1024];
+    char masterbuf[4096];
+    bool pollFailed = false;
     while (waitpid(m_child_pid, &ret, WNOHANG) == 0) {
+        if (poll(fds, 2, 1000) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+
+            // Don't leave dpkg behind, read its output once in a while
+            // instead until the loop reaps it
+            if (!pollFailed) {
+                g_warning("Failed to poll dpkg: %s", g_strerror(errno));
+                pollFailed = true;
+            }
+            g_usleep(G_USEC_PER_SEC / 10);
+            for (struct pollfd &pfd : fds) {
+                pfd.revents = pfd.fd == -1 ? 0 : POLLIN;
+            }
+        }
+
         // TODO: This is dpkg's raw output. Maybe save it for error-solving?
-        while(read(pty_master, masterbuf, sizeof(masterbuf)) > 0);
+        if (fds[1].revents & POLLIN) {
+            while(read(pty_master, masterbuf, sizeof(masterbuf)) > 0);
+        }
         updateInterface(readFromChildFD[0], pty_master);
+
+        // Stop watching closed ends, they would wake us up right away
+        for (struct pollfd &pfd : fds) {
+            if ((pfd.revents & (POLLHUP | POLLERR | POLLNVAL)) && !(pfd.revents & POLLIN)) {
+                pfd.fd = -1;
+            }
+        }
+
+        if (fds[0].fd == -1 && fds[1].fd == -1) {
+            // Nothing left to read, just wait for the child to exit
+            waitpid(m_child_pid, &ret, 0);
+            break;
+        }
     }
 
+    // dpkg may have written its last lines right before exiting
+    updateInterface(readFromChildFD[0], pty_master);
+
+    struct timespec cpuEnd;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpuEnd);
+    g_debug("Spent %.3f s of CPU time following dpkg",
+            (cpuEnd.tv_sec - cpuStart.tv_sec) + (cpuEnd.tv_nsec - cpuStart.tv_nsec) / 1e9);
+
     close(readFromChildFD[0]);
-    close(readFromChildFD[1]);
     close(pty_master);
 
     cout << "Parent finished..." << endl;
@@ -32,8 +32,11 @@
 
 #include <pk-backend.h>
 
+#include <atomic>
+
 #include "pkg-list.h"
 #include "apt-sourceslist.h"
+#include "apt-changelog.h"
 
 #define PREUPGRADE_BINARY    "/usr/bin/do-release-upgrade"
 #define REBOOT_REQUIRED      "/var/run/reboot-required"
@@ -48,6 +51,18 @@ public:
     ~AptIntf();
 
     bool init(gchar **localDebs = nullptr);
+
+    /**
+     *  Deletes the cache kept for the next job
+     */
+    static void freeIdleCache();
+
+    /**
+     *  Whether jobs of the given role only read the cache and can run
+     *  next to each other
+     */
+    static bool canRunInParallel(PkRoleEnum role);
+
     void cancel();
     bool cancelled() const;
 
@@ -168,6 +183,13 @@ public:
 
     void emitRequireRestart(PkgList &output);
 
+    /**
+      * Emits every package of the cache that matches the given filters,
+      * the cache is split between worker threads which filter the
+      * packages and build their package IDs
+      */
+    void emitAllPackages(PkBitfield filters);
+
     /**
       * Emits a list of updates that matches the given filters
       */
@@ -195,9 +217,9 @@ public:
     void emitDetails(PkgList &pkgs);
 
     /**
-      * Emits update detail
+      * Emits update detail with the given changelog
       */
-    void emitUpdateDetail(const pkgCache::VerIterator &candver);
+    void emitUpdateDetail(const pkgCache::VerIterator &candver, const AptChangelog &changelog);
 
     /**
       * Emits update datails for the given list
@@ -240,24 +262,86 @@ public:
     bool getArchive(pkgAcquire *Owner, pkgCache::VerIterator const &Version,
                     std::string directory, std::string &StoreFilename);
 
+    /**
+      * Finds the archives of \a versions which are already complete in
+      * \a directory, verifying their hashes in parallel
+      * @returns the path of the archive of every version, or an empty
+      * string where it has to be downloaded
+      */
+    vector<string> findArchives(const PkgList &versions, const string &directory);
+
     AptCacheFile* aptCacheFile() const;
 
+    /**
+     *  (Re)builds the on-disk indexes after the cache was refreshed
+     */
+    void buildIndexes();
+
 private:
+    /**
+     *  Filter attributes of a version, computed once per cache and
+     *  kept in AptCacheFile::versionAttributes()
+     */
+    enum {
+        VER_INSTALLED   = 1 << 0,
+        VER_NATIVE_ARCH = 1 << 1,
+        VER_DEVEL       = 1 << 2,
+        VER_GUI         = 1 << 3,
+        VER_FREE        = 1 << 4,
+        VER_SUPPORTED   = 1 << 5,
+        VER_APPLICATION = 1 << 6
+    };
+
+    /**
+     *  Takes the cache left by a previous job if it was opened while
+     *  the sources had the same \a stamp
+     */
+    static AptCacheFile* takeIdleCache(const string &stamp);
+
+    /**
+     *  Deletes the cache, or keeps it for the next job if it is
+     *  unchanged and still up to date
+     */
+    void releaseCache();
+
+    /**
+     *  Keeps the packages whose archive is already in the archives
+     *  directory
+     */
+    PkgList filterDownloaded(const PkgList &packages);
+
     bool checkTrusted(pkgAcquire &fetcher, PkBitfield flags);
-    bool packageIsSupported(const pkgCache::VerIterator &verIter, string component);
+    guint8 versionAttributes(const pkgCache::VerIterator &ver);
+    void buildVersionAttributes();
     bool isApplication(const pkgCache::VerIterator &verIter);
     bool matchesQueries(const vector<string> &queries, string s);
+    string sourcePackage(const pkgCache::VerIterator &ver);
+
+    /**
+     *  Adds the packages named \a name, or providing it when virtual
+     */
+    void providesPackage(PkgList &output, const string &name);
+
+    /**
+     *  Scans the dpkg list files for the files in \a values
+     */
+    void searchListFiles(gchar **values, vector<string> &packages);
 
     /**
-     *  interprets dpkg status fd
+     *  interprets dpkg status fd, reading what is available without
+     *  blocking
      */
     void updateInterface(int readFd, int writeFd);
+    void handleStatusLine(const gchar *line, int writeFd);
     PkgList checkChangedPackages(bool emitChanged);
     pkgCache::VerIterator findTransactionPackage(const std::string &name);
 
     AptCacheFile *m_cache;
+    bool          m_cacheReusable;
+    string        m_cacheStamp;
+    string        m_packageId;
     PkBackendJob  *m_job;
-    bool       m_cancel;
+    std::atomic<bool> m_cancel;
     struct stat m_restartStat;
 
     bool m_isMultiArch;
@@ -266,6 +350,7 @@ private:
 
     time_t     m_lastTermAction;
     string     m_lastPackage;
+    string     m_statusLine;
     uint       m_lastSubProgress;
     bool       m_startCounting;
     bool       m_interactive;
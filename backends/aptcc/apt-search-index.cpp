@@ -0,0 +1,279 @@
+/* apt-search-index.cpp - Trigram index of package names and descriptions
+ *
+ * Copyright (c) 2026 The PackageKit authors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include "apt-search-index.h"
+
+#include <apt-pkg/configuration.h>
+#include <apt-pkg/fileutl.h>
+#include <apt-pkg/pkgrecords.h>
+
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+#include <unordered_map>
+
+#include "apt-cache-file.h"
+
+#define SEARCH_INDEX_MAGIC   "PKTRI\0\0\1"
+#define SEARCH_INDEX_NAME    "search.idx"
+
+// The index starts with four words: the package count of the cache it
+// was built from, the number of name and description trigrams and a
+// spare one. The two sorted trigram tables follow, each entry being
+// { trigram, offset, count } into the posting lists stored at the end.
+#define HEADER_WORDS 4
+#define ENTRY_WORDS  3
+
+typedef std::unordered_map<guint32, vector<guint32> > PostingMap;
+
+/**
+ * Appends the trigrams of the given text, folded to lower case,
+ * trigrams with non ASCII bytes are skipped as their case folding
+ * depends on the locale
+ */
+static void collectTrigrams(const char *text, size_t length, vector<guint32> &trigrams)
+{
+    for (size_t i = 0; i + 3 <= length; ++i) {
+        const guchar a = text[i];
+        const guchar b = text[i + 1];
+        const guchar c = text[i + 2];
+        if ((a | b | c) & 0x80) {
+            continue;
+        }
+
+        trigrams.push_back(g_ascii_tolower(a) << 16 |
+                           g_ascii_tolower(b) << 8 |
+                           g_ascii_tolower(c));
+    }
+}
+
+static void addPostings(PostingMap &postings, vector<guint32> &trigrams, guint32 id)
+{
+    std::sort(trigrams.begin(), trigrams.end());
+    trigrams.erase(std::unique(trigrams.begin(), trigrams.end()), trigrams.end());
+    for (guint32 trigram : trigrams) {
+        postings[trigram].push_back(id);
+    }
+    trigrams.clear();
+}
+
+static void writeTable(const PostingMap &postings, vector<guint32> &table, vector<guint32> &lists)
+{
+    vector<guint32> keys;
+    keys.reserve(postings.size());
+    for (const auto &posting : postings) {
+        keys.push_back(posting.first);
+    }
+    std::sort(keys.begin(), keys.end());
+
+    for (guint32 trigram : keys) {
+        const vector<guint32> &ids = postings.at(trigram);
+        table.push_back(trigram);
+        table.push_back(lists.size());
+        table.push_back(ids.size());
+        lists.insert(lists.end(), ids.begin(), ids.end());
+    }
+}
+
+static string searchIndexSource()
+{
+    return _config->FindFile("Dir::Cache::pkgcache");
+}
+
+bool AptSearchIndex::open(pkgCache *cache)
+{
+    const string source = searchIndexSource();
+    if (source.empty() ||
+            !m_file.open(AptIndexFile::path(SEARCH_INDEX_NAME), SEARCH_INDEX_MAGIC, source)) {
+        return false;
+    }
+
+    const guint32 *words = reinterpret_cast<const guint32*>(m_file.data());
+    const gsize count = m_file.size() / sizeof(guint32);
+    if (count < HEADER_WORDS ||
+            words[0] != cache->HeaderP->PackageCount ||
+            count < HEADER_WORDS + (gsize(words[1]) + words[2]) * ENTRY_WORDS) {
+        g_debug("Ignoring invalid search index");
+        m_file.close();
+        return false;
+    }
+
+    m_names.entries = words + HEADER_WORDS;
+    m_names.count = words[1];
+    m_descriptions.entries = m_names.entries + m_names.count * ENTRY_WORDS;
+    m_descriptions.count = words[2];
+    m_postings = m_descriptions.entries + m_descriptions.count * ENTRY_WORDS;
+    m_postingsCount = count - (m_postings - words);
+    return true;
+}
+
+bool AptSearchIndex::findNames(const vector<string> &queries, vector<guint32> &ids) const
+{
+    return find(m_names, queries, ids);
+}
+
+bool AptSearchIndex::findDetails(const vector<string> &queries, vector<guint32> &ids) const
+{
+    vector<guint32> names;
+    vector<guint32> descriptions;
+    if (!find(m_names, queries, names) || !find(m_descriptions, queries, descriptions)) {
+        return false;
+    }
+
+    ids.clear();
+    std::set_union(names.begin(), names.end(),
+                   descriptions.begin(), descriptions.end(),
+                   std::back_inserter(ids));
+    return true;
+}
+
+bool AptSearchIndex::find(const Table &table, const vector<string> &queries, vector<guint32> &ids) const
+{
+    if (!m_file.isOpen()) {
+        return false;
+    }
+
+    ids.clear();
+    for (const string &query : queries) {
+        vector<guint32> trigrams;
+        collectTrigrams(query.data(), query.size(), trigrams);
+        if (trigrams.empty()) {
+            // Too short or nothing we can look up, every package
+            // might match this query
+            return false;
+        }
+        std::sort(trigrams.begin(), trigrams.end());
+        trigrams.erase(std::unique(trigrams.begin(), trigrams.end()), trigrams.end());
+
+        // Find the posting list of each trigram
+        vector<std::pair<const guint32*, guint32> > lists;
+        for (guint32 trigram : trigrams) {
+            guint32 low = 0;
+            guint32 high = table.count;
+            while (low < high) {
+                guint32 middle = low + (high - low) / 2;
+                if (table.entries[middle * ENTRY_WORDS] < trigram) {
+                    low = middle + 1;
+                } else {
+                    high = middle;
+                }
+            }
+
+            const guint32 *entry = table.entries + low * ENTRY_WORDS;
+            if (low == table.count || entry[0] != trigram) {
+                // No package has this trigram, the query can't match
+                lists.clear();
+                break;
+            }
+
+            if (gsize(entry[1]) + entry[2] > m_postingsCount) {
+                g_debug("Search index is corrupted");
+                return false;
+            }
+            lists.push_back(std::make_pair(m_postings + entry[1], entry[2]));
+        }
+
+        if (lists.empty()) {
+            continue;
+        }
+
+        // Intersect starting from the shortest list
+        std::sort(lists.begin(), lists.end(),
+                  [](const std::pair<const guint32*, guint32> &a,
+                     const std::pair<const guint32*, guint32> &b) {
+            return a.second < b.second;
+        });
+
+        vector<guint32> matches(lists[0].first, lists[0].first + lists[0].second);
+        for (size_t i = 1; i < lists.size() && !matches.empty(); ++i) {
+            vector<guint32> intersection;
+            std::set_intersection(matches.begin(), matches.end(),
+                                  lists[i].first, lists[i].first + lists[i].second,
+                                  std::back_inserter(intersection));
+            matches.swap(intersection);
+        }
+
+        vector<guint32> merged;
+        std::set_union(ids.begin(), ids.end(),
+                       matches.begin(), matches.end(),
+                       std::back_inserter(merged));
+        ids.swap(merged);
+    }
+
+    return true;
+}
+
+bool AptSearchIndex::build(AptCacheFile &cache)
+{
+    const string source = searchIndexSource();
+    if (source.empty() || !FileExists(source)) {
+        return false;
+    }
+
+    pkgCache *pkgs = cache.GetPkgCache();
+    pkgRecords *records = cache.GetPkgRecords();
+    if (pkgs == nullptr || records == nullptr) {
+        return false;
+    }
+
+    PostingMap names;
+    PostingMap descriptions;
+    vector<guint32> trigrams;
+    for (pkgCache::PkgIterator pkg = pkgs->PkgBegin(); !pkg.end(); ++pkg) {
+        // Ignore packages that exist only due to dependencies.
+        if (pkg.VersionList().end() && pkg.ProvidesList().end()) {
+            continue;
+        }
+
+        collectTrigrams(pkg.Name(), strlen(pkg.Name()), trigrams);
+        addPostings(names, trigrams, pkg->ID);
+
+        // Index every version and translation, the one shown depends
+        // on the policy and locale of each search
+        for (pkgCache::VerIterator ver = pkg.VersionList(); !ver.end(); ++ver) {
+            for (pkgCache::DescIterator desc = ver.DescriptionList(); !desc.end(); ++desc) {
+                pkgCache::DescFileIterator df = desc.FileList();
+                if (df.end()) {
+                    continue;
+                }
+
+                const string longDesc = records->Lookup(df).LongDesc();
+                collectTrigrams(longDesc.data(), longDesc.size(), trigrams);
+            }
+        }
+        addPostings(descriptions, trigrams, pkg->ID);
+    }
+
+    vector<guint32> index;
+    vector<guint32> lists;
+    index.push_back(pkgs->HeaderP->PackageCount);
+    index.push_back(names.size());
+    index.push_back(descriptions.size());
+    index.push_back(0);
+    writeTable(names, index, lists);
+    writeTable(descriptions, index, lists);
+    index.insert(index.end(), lists.begin(), lists.end());
+
+    return AptIndexFile::save(AptIndexFile::path(SEARCH_INDEX_NAME),
+                              SEARCH_INDEX_MAGIC,
+                              source,
+                              string(reinterpret_cast<const char*>(index.data()),
+                                     index.size() * sizeof(guint32)));
+}
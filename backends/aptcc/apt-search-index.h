@@ -0,0 +1,90 @@
+/* apt-search-index.h - Trigram index of package names and descriptions
+ *
+ * Copyright (c) 2026 The PackageKit authors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef APT_SEARCH_INDEX_H
+#define APT_SEARCH_INDEX_H
+
+#include <apt-pkg/pkgcache.h>
+
+#include <string>
+#include <vector>
+
+#include "apt-index-file.h"
+
+using std::string;
+using std::vector;
+
+class AptCacheFile;
+
+/**
+ * Maps lower case trigrams of package names and long descriptions to
+ * the IDs of the packages containing them.
+ *
+ * The index is built when the cache is refreshed and is only used while
+ * pkgcache.bin is unchanged, it returns candidates which still have to
+ * be checked against the real name or description.
+ *
+ * pkgcache.bin is regenerated after every dpkg run, so installing or
+ * removing a package leaves the index stale until the next refresh;
+ * searches scan the whole cache meanwhile. Building it takes too long
+ * to do whenever the cache is opened.
+ */
+class AptSearchIndex
+{
+public:
+    /**
+     * Maps the index if it was built for the current package cache
+     */
+    bool open(pkgCache *cache);
+
+    /**
+     * Fills \a ids with the sorted IDs of packages whose name may
+     * contain one of the queries
+     * @returns false if the index can't answer the queries, the caller
+     * must fall back to scanning every package
+     */
+    bool findNames(const vector<string> &queries, vector<guint32> &ids) const;
+
+    /**
+     * Same as findNames() but also considers the long descriptions
+     */
+    bool findDetails(const vector<string> &queries, vector<guint32> &ids) const;
+
+    /**
+     * Builds the index for the given cache
+     */
+    static bool build(AptCacheFile &cache);
+
+private:
+    struct Table {
+        const guint32 *entries = nullptr;
+        guint32 count = 0;
+    };
+
+    bool find(const Table &table, const vector<string> &queries, vector<guint32> &ids) const;
+
+    AptIndexFile m_file;
+    Table m_names;
+    Table m_descriptions;
+    const guint32 *m_postings = nullptr;
+    gsize m_postingsCount = 0;
+};
+
+#endif // APT_SEARCH_INDEX_H
@@ -0,0 +1,241 @@
+/* apt-soname-index.cpp - Index of the packages shipping a shared library
+ *
+ * Copyright (c) 2026 The PackageKit authors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include "apt-soname-index.h"
+
+#include <apt-pkg/configuration.h>
+#include <apt-pkg/fileutl.h>
+
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <set>
+
+#define SONAME_INDEX_MAGIC   "PKSON\0\0\1"
+#define SONAME_INDEX_NAME    "sonames.idx"
+
+// The index starts with four words: the number of entries, the size of
+// the string pool and two spare ones. The entries follow sorted by
+// soname as { soname, package } offsets into the string pool.
+#define HEADER_WORDS 4
+#define ENTRY_WORDS  2
+
+static string sonameIndexSource()
+{
+    return _config->FindDir("Dir::State::lists");
+}
+
+/**
+ * Adds the library listed on a Contents line, formatted as
+ * "usr/lib/libfoo.so.1   libs/libfoo1,oldlibs/libfoo1-compat"
+ */
+static void addContentsLine(const char *line, std::map<string, std::set<string> > &sonames)
+{
+    const char *end = line + strlen(line);
+    while (end > line && g_ascii_isspace(end[-1])) {
+        --end;
+    }
+
+    const char *packages = end;
+    while (packages > line && !g_ascii_isspace(packages[-1])) {
+        --packages;
+    }
+
+    const char *pathEnd = packages;
+    while (pathEnd > line && g_ascii_isspace(pathEnd[-1])) {
+        --pathEnd;
+    }
+    if (pathEnd == line) {
+        return;
+    }
+
+    const char *name = pathEnd;
+    while (name > line && name[-1] != '/') {
+        --name;
+    }
+
+    const string soname(name, pathEnd - name);
+    if (!g_str_has_prefix(soname.c_str(), "lib") || soname.find(".so.") == string::npos) {
+        return;
+    }
+
+    // Keep the package names only, without their section
+    std::set<string> &owners = sonames[soname];
+    const string list(packages, end - packages);
+    size_t start = 0;
+    while (start < list.size()) {
+        size_t comma = list.find(',', start);
+        if (comma == string::npos) {
+            comma = list.size();
+        }
+        const size_t slash = list.rfind('/', comma - 1);
+        const size_t begin = slash == string::npos || slash < start ? start : slash + 1;
+        if (comma > begin) {
+            owners.insert(list.substr(begin, comma - begin));
+        }
+        start = comma + 1;
+    }
+}
+
+bool AptSonameIndex::open()
+{
+    const string source = sonameIndexSource();
+    if (source.empty() ||
+            !m_file.open(AptIndexFile::path(SONAME_INDEX_NAME), SONAME_INDEX_MAGIC, source)) {
+        return false;
+    }
+
+    const guint32 *words = reinterpret_cast<const guint32*>(m_file.data());
+    const gsize count = m_file.size() / sizeof(guint32);
+    if (count < HEADER_WORDS ||
+            m_file.size() < (HEADER_WORDS + gsize(words[0]) * ENTRY_WORDS) * sizeof(guint32) + words[1]) {
+        g_debug("Ignoring invalid soname index");
+        m_file.close();
+        return false;
+    }
+
+    m_entryCount = words[0];
+    const guint32 stringsSize = words[1];
+    m_entries = words + HEADER_WORDS;
+    m_strings = reinterpret_cast<const gchar*>(m_entries + m_entryCount * ENTRY_WORDS);
+
+    // Check every offset once so lookups don't have to
+    bool valid = stringsSize == 0 || m_strings[stringsSize - 1] == '\0';
+    for (guint32 i = 0; valid && i < m_entryCount * ENTRY_WORDS; ++i) {
+        valid = m_entries[i] < stringsSize;
+    }
+
+    if (!valid) {
+        g_debug("Soname index is corrupted");
+        m_file.close();
+        return false;
+    }
+    return true;
+}
+
+void AptSonameIndex::find(const char *soname, vector<string> &packages) const
+{
+    if (!m_file.isOpen()) {
+        return;
+    }
+
+    guint32 low = 0;
+    guint32 high = m_entryCount;
+    while (low < high) {
+        guint32 middle = low + (high - low) / 2;
+        if (strcmp(m_strings + m_entries[middle * ENTRY_WORDS], soname) < 0) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+
+    for (guint32 i = low; i < m_entryCount; ++i) {
+        const guint32 *entry = m_entries + i * ENTRY_WORDS;
+        if (strcmp(m_strings + entry[0], soname) != 0) {
+            break;
+        }
+        packages.push_back(m_strings + entry[1]);
+    }
+}
+
+bool AptSonameIndex::build()
+{
+    const string source = sonameIndexSource();
+    if (source.empty() || !DirectoryExists(source)) {
+        return false;
+    }
+
+    AptSonameIndex current;
+    if (current.open()) {
+        return true;
+    }
+
+    // GetListOfFilesInDir() applies the run-parts name rules, which
+    // reject the dots every list file has, read the directory directly
+    GDir *dir = g_dir_open(source.c_str(), 0, NULL);
+    if (dir == NULL) {
+        return false;
+    }
+
+    std::map<string, std::set<string> > sonames;
+    char buffer[4096];
+    guint contentsFiles = 0;
+    const gchar *name;
+    while ((name = g_dir_read_name(dir)) != NULL) {
+        if (strstr(name, "_Contents-") == NULL) {
+            continue;
+        }
+
+        FileFd fd;
+        if (!fd.Open(flCombine(source, name), FileFd::ReadOnly, FileFd::Extension)) {
+            continue;
+        }
+        ++contentsFiles;
+        while (fd.ReadLine(buffer, sizeof(buffer)) != nullptr) {
+            addContentsLine(buffer, sonames);
+        }
+    }
+    g_dir_close(dir);
+
+    if (contentsFiles > 0 && sonames.empty()) {
+        g_warning("No libraries found in %u Contents files, not writing the soname index",
+                  contentsFiles);
+        return false;
+    }
+
+    // Package names are shared by many sonames, store each once
+    string strings;
+    std::map<string, guint32> packageOffsets;
+    vector<guint32> entries;
+    for (const auto &soname : sonames) {
+        const guint32 sonameOffset = strings.size();
+        strings.append(soname.first);
+        strings.push_back('\0');
+        for (const string &package : soname.second) {
+            auto it = packageOffsets.find(package);
+            if (it == packageOffsets.end()) {
+                it = packageOffsets.emplace(package, strings.size()).first;
+                strings.append(package);
+                strings.push_back('\0');
+            }
+            entries.push_back(sonameOffset);
+            entries.push_back(it->second);
+        }
+    }
+
+    g_debug("Indexing %zu sonames from %u Contents files", sonames.size(), contentsFiles);
+
+    vector<guint32> index;
+    index.reserve(HEADER_WORDS + entries.size());
+    index.push_back(entries.size() / ENTRY_WORDS);
+    index.push_back(strings.size());
+    index.push_back(0);
+    index.push_back(0);
+    index.insert(index.end(), entries.begin(), entries.end());
+
+    string contents(reinterpret_cast<const char*>(index.data()),
+                    index.size() * sizeof(guint32));
+    contents.append(strings);
+    return AptIndexFile::save(AptIndexFile::path(SONAME_INDEX_NAME),
+                              SONAME_INDEX_MAGIC,
+                              source,
+                              contents);
+}
@@ -0,0 +1,66 @@
+/* apt-soname-index.h - Index of the packages shipping a shared library
+ *
+ * Copyright (c) 2026 The PackageKit authors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef APT_SONAME_INDEX_H
+#define APT_SONAME_INDEX_H
+
+#include <glib.h>
+
+#include <string>
+#include <vector>
+
+#include "apt-index-file.h"
+
+using std::string;
+using std::vector;
+
+/**
+ * Maps library sonames to the names of the packages shipping them.
+ *
+ * The index is built from the Contents files downloaded next to the
+ * package lists (e.g. by apt-file), it is empty when there are none.
+ */
+class AptSonameIndex
+{
+public:
+    /**
+     * Maps the index if it is up to date with the package lists
+     */
+    bool open();
+
+    /**
+     * Appends the packages shipping \a soname to \a packages
+     */
+    void find(const char *soname, vector<string> &packages) const;
+
+    /**
+     * Writes a new index from the Contents files, unless the current
+     * one is up to date
+     */
+    static bool build();
+
+private:
+    AptIndexFile m_file;
+    const guint32 *m_entries = nullptr;
+    guint32 m_entryCount = 0;
+    const gchar *m_strings = nullptr;
+};
+
+#endif // APT_SONAME_INDEX_H
@@ -0,0 +1,148 @@
+/* apt-summary-index.cpp - Table of the short descriptions of packages
+ *
+ * Copyright (c) 2026 The PackageKit authors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include "apt-summary-index.h"
+
+#include <apt-pkg/configuration.h>
+#include <apt-pkg/fileutl.h>
+#include <apt-pkg/pkgrecords.h>
+
+#include <vector>
+
+#include "apt-cache-file.h"
+
+#define SUMMARY_INDEX_MAGIC   "PKSUM\0\0\1"
+#define SUMMARY_INDEX_NAME    "summaries.idx"
+
+// The table starts with four words: the description count of the cache
+// it was built from, the size of the string pool and two spare ones.
+// Then follows the offset of the summary of every description into the
+// string pool, NO_SUMMARY for descriptions without a record.
+#define HEADER_WORDS 4
+#define NO_SUMMARY   G_MAXUINT32
+
+static string summaryIndexSource()
+{
+    return _config->FindFile("Dir::Cache::pkgcache");
+}
+
+bool AptSummaryIndex::open(pkgCache *cache)
+{
+    const string source = summaryIndexSource();
+    if (source.empty() ||
+            !m_file.open(AptIndexFile::path(SUMMARY_INDEX_NAME), SUMMARY_INDEX_MAGIC, source)) {
+        return false;
+    }
+
+    const guint32 *words = reinterpret_cast<const guint32*>(m_file.data());
+    const gsize count = m_file.size() / sizeof(guint32);
+    if (count < HEADER_WORDS ||
+            words[0] != cache->HeaderP->DescriptionCount ||
+            m_file.size() < (HEADER_WORDS + gsize(words[0])) * sizeof(guint32) + words[1]) {
+        g_debug("Ignoring invalid summary index");
+        m_file.close();
+        return false;
+    }
+
+    m_count = words[0];
+    const guint32 stringsSize = words[1];
+    m_offsets = words + HEADER_WORDS;
+    m_strings = reinterpret_cast<const gchar*>(m_offsets + m_count);
+
+    // Check every offset once so lookups don't have to
+    bool valid = stringsSize == 0 || m_strings[stringsSize - 1] == '\0';
+    for (guint32 i = 0; valid && i < m_count; ++i) {
+        valid = m_offsets[i] == NO_SUMMARY || m_offsets[i] < stringsSize;
+    }
+
+    if (!valid) {
+        g_debug("Summary index is corrupted");
+        m_file.close();
+        return false;
+    }
+    return true;
+}
+
+void AptSummaryIndex::close()
+{
+    m_file.close();
+}
+
+bool AptSummaryIndex::find(const pkgCache::DescIterator &desc, string &summary) const
+{
+    if (!m_file.isOpen() || desc->ID >= m_count) {
+        return false;
+    }
+
+    const guint32 offset = m_offsets[desc->ID];
+    if (offset == NO_SUMMARY) {
+        summary.clear();
+    } else {
+        summary = m_strings + offset;
+    }
+    return true;
+}
+
+bool AptSummaryIndex::build(AptCacheFile &cache)
+{
+    const string source = summaryIndexSource();
+    if (source.empty() || !FileExists(source)) {
+        return false;
+    }
+
+    pkgCache *pkgs = cache.GetPkgCache();
+    pkgRecords *records = cache.GetPkgRecords();
+    if (pkgs == nullptr || records == nullptr) {
+        return false;
+    }
+
+    std::vector<guint32> offsets(pkgs->HeaderP->DescriptionCount, NO_SUMMARY);
+    string strings;
+    for (pkgCache::PkgIterator pkg = pkgs->PkgBegin(); !pkg.end(); ++pkg) {
+        for (pkgCache::VerIterator ver = pkg.VersionList(); !ver.end(); ++ver) {
+            for (pkgCache::DescIterator desc = ver.DescriptionList(); !desc.end(); ++desc) {
+                pkgCache::DescFileIterator df = desc.FileList();
+                if (df.end() || desc->ID >= offsets.size() || offsets[desc->ID] != NO_SUMMARY) {
+                    continue;
+                }
+
+                offsets[desc->ID] = strings.size();
+                strings.append(records->Lookup(df).ShortDesc());
+                strings.push_back('\0');
+            }
+        }
+    }
+
+    std::vector<guint32> index;
+    index.reserve(HEADER_WORDS + offsets.size());
+    index.push_back(pkgs->HeaderP->DescriptionCount);
+    index.push_back(strings.size());
+    index.push_back(0);
+    index.push_back(0);
+    index.insert(index.end(), offsets.begin(), offsets.end());
+
+    string contents(reinterpret_cast<const char*>(index.data()),
+                    index.size() * sizeof(guint32));
+    contents.append(strings);
+    return AptIndexFile::save(AptIndexFile::path(SUMMARY_INDEX_NAME),
+                              SUMMARY_INDEX_MAGIC,
+                              source,
+                              contents);
+}
@@ -0,0 +1,73 @@
+/* apt-summary-index.h - Table of the short descriptions of packages
+ *
+ * Copyright (c) 2026 The PackageKit authors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef APT_SUMMARY_INDEX_H
+#define APT_SUMMARY_INDEX_H
+
+#include <apt-pkg/pkgcache.h>
+
+#include <string>
+
+#include "apt-index-file.h"
+
+using std::string;
+
+class AptCacheFile;
+
+/**
+ * Holds the short description of every description of the package
+ * cache, indexed by the description ID.
+ *
+ * Emitting a package needs its summary, reading it from here instead
+ * of the package records avoids a seek into the lists for every
+ * package. Like the search index, it is only used while pkgcache.bin
+ * is unchanged. As every emission reads it, the cache rebuilds it when
+ * it is opened after pkgcache.bin was regenerated.
+ */
+class AptSummaryIndex
+{
+public:
+    /**
+     * Maps the table if it was built for the given package cache
+     */
+    bool open(pkgCache *cache);
+
+    void close();
+
+    /**
+     * Sets \a summary to the short description of \a desc
+     * @returns false if the table isn't open, the caller must read
+     * the package records
+     */
+    bool find(const pkgCache::DescIterator &desc, string &summary) const;
+
+    /**
+     * Builds the table for the given cache
+     */
+    static bool build(AptCacheFile &cache);
+
+private:
+    AptIndexFile m_file;
+    const guint32 *m_offsets = nullptr;
+    guint32 m_count = 0;
+    const gchar *m_strings = nullptr;
+};
+
+#endif // APT_SUMMARY_INDEX_H
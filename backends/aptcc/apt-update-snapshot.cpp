@@ -0,0 +1,147 @@
+/* apt-update-snapshot.cpp - Saved result of the update calculation
+ *
+ * Copyright (c) 2026 The PackageKit authors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include "apt-update-snapshot.h"
+
+#include <apt-pkg/configuration.h>
+#include <apt-pkg/fileutl.h>
+
+#include <vector>
+
+#include "apt-cache-file.h"
+#include "apt-index-file.h"
+
+#define UPDATE_SNAPSHOT_MAGIC   "PKUPD\0\0\1"
+#define UPDATE_SNAPSHOT_NAME    "updates.snap"
+
+// The snapshot starts with eight words: the version count of the cache
+// it was computed with, the length of the stamp, the number of updates,
+// blocked updates and downgrades and three spare ones. Then follow the
+// version IDs of the three lists and the stamp.
+#define HEADER_WORDS 8
+
+static string updateSnapshotSource()
+{
+    return _config->FindFile("Dir::Cache::pkgcache");
+}
+
+static bool readVersions(AptCacheFile &cache, const guint32 *ids, guint32 count, PkgList &versions)
+{
+    for (guint32 i = 0; i < count; ++i) {
+        const pkgCache::VerIterator ver = cache.findVersionById(ids[i]);
+        if (ver.end()) {
+            return false;
+        }
+        versions.push_back(ver);
+    }
+    return true;
+}
+
+static void writeVersions(const PkgList &versions, std::vector<guint32> &ids)
+{
+    for (const pkgCache::VerIterator &ver : versions) {
+        ids.push_back(ver->ID);
+    }
+}
+
+bool AptUpdateSnapshot::load(AptCacheFile &cache,
+                             const string &stamp,
+                             PkgList &updates,
+                             PkgList &blocked,
+                             PkgList &downgrades)
+{
+    const string source = updateSnapshotSource();
+    pkgCache *pkgs = cache.GetPkgCache();
+    AptIndexFile file;
+    if (source.empty() || pkgs == nullptr ||
+            !file.open(AptIndexFile::path(UPDATE_SNAPSHOT_NAME), UPDATE_SNAPSHOT_MAGIC, source)) {
+        return false;
+    }
+
+    const guint32 *words = reinterpret_cast<const guint32*>(file.data());
+    const gsize count = file.size() / sizeof(guint32);
+    if (count < HEADER_WORDS || words[0] != pkgs->HeaderP->VersionCount) {
+        g_debug("Ignoring invalid update snapshot");
+        return false;
+    }
+
+    const gsize idCount = gsize(words[2]) + words[3] + words[4];
+    if (file.size() < (HEADER_WORDS + idCount) * sizeof(guint32) + words[1]) {
+        g_debug("Ignoring invalid update snapshot");
+        return false;
+    }
+
+    const guint32 *ids = words + HEADER_WORDS;
+    const string savedStamp(reinterpret_cast<const char*>(ids + idCount), words[1]);
+    if (savedStamp != stamp) {
+        g_debug("Ignoring stale update snapshot");
+        return false;
+    }
+
+    PkgList savedUpdates;
+    PkgList savedBlocked;
+    PkgList savedDowngrades;
+    if (!readVersions(cache, ids, words[2], savedUpdates) ||
+            !readVersions(cache, ids + words[2], words[3], savedBlocked) ||
+            !readVersions(cache, ids + words[2] + words[3], words[4], savedDowngrades)) {
+        g_debug("Update snapshot is corrupted");
+        return false;
+    }
+
+    updates.insert(updates.end(), savedUpdates.begin(), savedUpdates.end());
+    blocked.insert(blocked.end(), savedBlocked.begin(), savedBlocked.end());
+    downgrades.insert(downgrades.end(), savedDowngrades.begin(), savedDowngrades.end());
+    return true;
+}
+
+bool AptUpdateSnapshot::save(AptCacheFile &cache,
+                             const string &stamp,
+                             const PkgList &updates,
+                             const PkgList &blocked,
+                             const PkgList &downgrades)
+{
+    const string source = updateSnapshotSource();
+    pkgCache *pkgs = cache.GetPkgCache();
+    if (source.empty() || pkgs == nullptr || !FileExists(source)) {
+        return false;
+    }
+
+    std::vector<guint32> snapshot;
+    snapshot.reserve(HEADER_WORDS + updates.size() + blocked.size() + downgrades.size());
+    snapshot.push_back(pkgs->HeaderP->VersionCount);
+    snapshot.push_back(stamp.size());
+    snapshot.push_back(updates.size());
+    snapshot.push_back(blocked.size());
+    snapshot.push_back(downgrades.size());
+    snapshot.push_back(0);
+    snapshot.push_back(0);
+    snapshot.push_back(0);
+    writeVersions(updates, snapshot);
+    writeVersions(blocked, snapshot);
+    writeVersions(downgrades, snapshot);
+
+    string contents(reinterpret_cast<const char*>(snapshot.data()),
+                    snapshot.size() * sizeof(guint32));
+    contents.append(stamp);
+    return AptIndexFile::save(AptIndexFile::path(UPDATE_SNAPSHOT_NAME),
+                              UPDATE_SNAPSHOT_MAGIC,
+                              source,
+                              contents);
+}
@@ -0,0 +1,64 @@
+/* apt-update-snapshot.h - Saved result of the update calculation
+ *
+ * Copyright (c) 2026 The PackageKit authors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef APT_UPDATE_SNAPSHOT_H
+#define APT_UPDATE_SNAPSHOT_H
+
+#include <string>
+
+#include "pkg-list.h"
+
+using std::string;
+
+class AptCacheFile;
+
+/**
+ * Holds the updates, blocked updates and downgrades computed for a
+ * given state of the system, by version ID.
+ *
+ * Finding them means running the upgrade resolver over the whole cache,
+ * while update notifiers ask again and again for an unchanged system.
+ * The snapshot is tied to the pkgcache.bin it was computed with and to
+ * the stamp of the dpkg status and apt preferences it was saved for.
+ */
+class AptUpdateSnapshot
+{
+public:
+    /**
+     * Reads the lists saved for \a stamp
+     * @returns false if there are none, the caller must compute them
+     */
+    static bool load(AptCacheFile &cache,
+                     const string &stamp,
+                     PkgList &updates,
+                     PkgList &blocked,
+                     PkgList &downgrades);
+
+    /**
+     * Saves the lists computed for \a stamp
+     */
+    static bool save(AptCacheFile &cache,
+                     const string &stamp,
+                     const PkgList &updates,
+                     const PkgList &blocked,
+                     const PkgList &downgrades);
+};
+
+#endif // APT_UPDATE_SNAPSHOT_H
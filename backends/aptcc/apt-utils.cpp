@@ -21,6 +21,8 @@
 
 #include "apt-utils.h"
 
+#include <apt-pkg/configuration.h>
+#include <apt-pkg/fileutl.h>
 #include <apt-pkg/version.h>
 #include <apt-pkg/acquire-item.h>
 #include <glib/gstdio.h>
@@ -127,39 +129,23 @@ bool strIsPrefix(string const& s1, string const&s2)
     return true;
 }
 
-string fetchChangelogData(AptCacheFile &CacheFile,
-                          pkgAcquire &Fetcher,
-                          pkgCache::VerIterator Ver,
-                          pkgCache::VerIterator currver,
-                          string *update_text,
-                          string *updated,
-                          string *issued)
+string parseChangelog(const string &fileName,
+                      const string &srcpkg,
+                      pkgCache::VerIterator currver,
+                      string *update_text,
+                      string *updated,
+                      string *issued)
 {
     string changelog;
 
-    pkgAcqChangelog *c = new pkgAcqChangelog(&Fetcher, Ver);
-
-    // try downloading it, if that fails, try third-party-changelogs location
-    // FIXME: Fetcher.Run() is "Continue" even if I get a 404?!?
-    Fetcher.Run();
-
-    // error
-    pkgRecords Recs(CacheFile);
-    pkgCache::PkgIterator Pkg = Ver.ParentPkg();
-    pkgRecords::Parser &rec=Recs.Lookup(Ver.FileList());
-    string srcpkg = rec.SourcePkg().empty() ? Pkg.Name() : rec.SourcePkg();
     changelog = "Changelog for this version is not yet available";
 
     // return empty string if we don't have a file to read
-    if (!FileExists(c->DestFile)) {
+    if (!FileExists(fileName)) {
         return changelog;
     }
 
-    if (_error->PendingError()) {
-        return changelog;
-    }
-
-    ifstream in(c->DestFile.c_str());
+    ifstream in(fileName.c_str());
     string line;
     g_autoptr(GRegex) regexVer = NULL;
     regexVer = g_regex_new("(?'source'.+) \\((?'version'.*)\\) "
@@ -365,26 +351,31 @@ bool utilRestartRequired(const string &packageName)
 
 string utilBuildPackageOriginId(pkgCache::VerFileIterator vf)
 {
-    if (vf.File().Origin() == NULL)
+    return utilBuildPackageOriginId(vf.File());
+}
+
+string utilBuildPackageOriginId(pkgCache::PkgFileIterator file)
+{
+    if (file.Origin() == NULL)
         return string("local");
-    if (vf.File().Archive() == NULL)
+    if (file.Archive() == NULL)
         return string("local");
-    if (vf.File().Component() == NULL)
+    if (file.Component() == NULL)
         return string("invalid");
 
     // https://wiki.debian.org/DebianRepository/Format
     // Optional field indicating the origin of the repository, a single line of free form text.
     // e.g. "Debian" or "Google Inc."
-    auto origin = string(vf.File().Origin());
+    auto origin = string(file.Origin());
     // The Suite field may describe the suite. A suite is a single word.
     // e.g. "jessie" or "sid"
-    auto suite = string(vf.File().Archive());
+    auto suite = string(file.Archive());
     // An area within the repository. May be prefixed by parts of the path
     // following the directory beneath dists.
     // e.g. "main" or "non-free"
     // NOTE: this may need the slash stripped, currently having a slash doesn't
     //    seem a problem though. we'll allow them until otherwise indicated
-    auto component = string(vf.File().Component());
+    auto component = string(file.Component());
 
     // Origin is defined as 'a single line of free form text'.
     // Sanitize it!
@@ -394,36 +385,35 @@ string utilBuildPackageOriginId(pkgCache::VerFileIterator vf)
     // so we must not have them appear in our package_ids as that would break
     // any number of higher level features.
     std::transform(origin.begin(), origin.end(), origin.begin(), ::tolower);
-    origin = std::regex_replace(origin, std::regex("[[:space:][:cntrl:][:punct:]]+"), "_");
+    static const std::regex separators("[[:space:][:cntrl:][:punct:]]+");
+    origin = std::regex_replace(origin, separators, "_");
 
     string res = origin + "-" + suite + "-" + component;
     return res;
 }
 
-gchar* utilBuildPackageId(const pkgCache::VerIterator &ver)
+string utilDpkgInfoDir()
 {
-    gchar *package_id;
-    pkgCache::VerFileIterator vf = ver.FileList();
-
-    string data = "";
-    const pkgCache::PkgIterator &pkg = ver.ParentPkg();
-    if (pkg->CurrentState == pkgCache::State::Installed && pkg.CurrentVer() == ver) {
-        // when a package is installed, the data part of a package-id is "installed:<repo-id>"
-        data = "installed:" + utilBuildPackageOriginId(vf);
-    } else {
-        data = utilBuildPackageOriginId(vf);
+    const string status = _config->FindFile("Dir::State::status");
+    if (status.empty()) {
+        return "/var/lib/dpkg/info/";
     }
-
-    package_id = pk_package_id_build(ver.ParentPkg().Name(),
-                                     ver.VerStr(),
-                                     ver.Arch(),
-                                     data.c_str());
-    return package_id;
+    return flNotFile(status) + "info/";
 }
 
+/**
+ * The last string converted by utf8() in a thread, freed when the
+ * thread exits as every job runs in a thread of its own
+ */
+struct Utf8Buffer
+{
+    char *str = NULL;
+    ~Utf8Buffer() { g_free(str); }
+};
+
 const char *utf8(const char *str)
 {
-    static char *_str = NULL;
+    static thread_local Utf8Buffer _str;
     if (str == NULL) {
         return NULL;
     }
@@ -432,8 +422,7 @@ const char *utf8(const char *str)
         return str;
     }
 
-    g_free(_str);
-    _str = NULL;
-    _str = g_locale_to_utf8(str, -1, NULL, NULL, NULL);
-    return _str;
+    g_free(_str.str);
+    _str.str = g_locale_to_utf8(str, -1, NULL, NULL, NULL);
+    return _str.str;
 }
@@ -36,15 +36,15 @@ using namespace std;
 PkGroupEnum get_enum_group(string group);
 
 /**
-  * Return the changelog and extract details about the changes.
+  * Return the downloaded changelog of the source package and extract
+  * details about the changes since the current version.
   */
-string fetchChangelogData(AptCacheFile &CacheFile,
-                          pkgAcquire &Fetcher,
-                          pkgCache::VerIterator Ver,
-                          pkgCache::VerIterator currver,
-                          string *update_text,
-                          string *updated,
-                          string *issued);
+string parseChangelog(const string &fileName,
+                      const string &srcpkg,
+                      pkgCache::VerIterator currver,
+                      string *update_text,
+                      string *updated,
+                      string *issued);
 
 /**
   * Returns a list of links pairs url;description for CVEs
@@ -71,18 +71,22 @@ bool starts_with(const string &str, const char *end);
   */
 bool utilRestartRequired(const string &packageName);
 
-/**
-  * Build a package id from the given package version
-  * The caller must g_free the returned value
-  */
-gchar* utilBuildPackageId(const pkgCache::VerIterator &ver);
-
 /**
  * Build a unique repository origin, in the form of
  * {distro}-{suite}-{component}
  */
 string utilBuildPackageOriginId(pkgCache::VerFileIterator vf);
 
+/**
+ * Build the repository origin of the given package file
+ */
+string utilBuildPackageOriginId(pkgCache::PkgFileIterator file);
+
+/**
+  * The directory of the dpkg file lists, next to the dpkg status file
+  */
+string utilDpkgInfoDir();
+
 /**
   * Return an utf8 string
   */
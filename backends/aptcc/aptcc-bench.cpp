@@ -0,0 +1,801 @@
+/* aptcc-bench.cpp - Measures the query roles of the APTcc backend
+ *
+ * Copyright (c) 2026 The PackageKit authors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; see the file COPYING.  If not, write to
+ * the Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/*
+ * Generates a synthetic archive, dpkg status and dpkg info tree, points
+ * apt at it and runs the query roles of AptIntf against it, printing
+ * their latency and the number of allocations they made.
+ *
+ * Every role must emit what the generated system holds, and the searches
+ * must find the same packages with and without the backend indexes, the
+ * benchmark fails otherwise.
+ *
+ *   make aptcc-bench
+ *   ./aptcc-bench --packages 50000 --iterations 5
+ *
+ * The daemon side of the jobs is replaced by the functions below, which
+ * only count what the backend emits.
+ */
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <ftw.h>
+#include <pk-backend.h>
+
+#include <apt-pkg/configuration.h>
+#include <apt-pkg/error.h>
+#include <apt-pkg/init.h>
+#include <apt-pkg/pkgsystem.h>
+#include <apt-pkg/strutl.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "apt-intf.h"
+#include "apt-cache-file.h"
+#include "apt-utils.h"
+
+using std::string;
+using std::vector;
+
+static std::atomic<guint64> allocations(0);
+static guint64 emitted = 0;
+static std::set<string> *emittedIds = NULL;
+static PkRoleEnum currentRole = PK_ROLE_ENUM_UNKNOWN;
+
+// Count every allocation of the process, including the ones of
+// libapt-pkg and GLib. This relies on the glibc allocator entry points.
+extern "C" {
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t count, size_t size);
+void *__libc_realloc(void *ptr, size_t size);
+
+void *malloc(size_t size)
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t count, size_t size)
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    return __libc_calloc(count, size);
+}
+
+void *realloc(void *ptr, size_t size)
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    return __libc_realloc(ptr, size);
+}
+}
+
+/* The parts of PkBackendJob the backend uses */
+
+gboolean pk_backend_is_online(PkBackend *backend)
+{
+    return FALSE;
+}
+
+gpointer pk_backend_job_get_backend(PkBackendJob *job)
+{
+    return NULL;
+}
+
+PkRoleEnum pk_backend_job_get_role(PkBackendJob *job)
+{
+    return currentRole;
+}
+
+PkBitfield pk_backend_job_get_transaction_flags(PkBackendJob *job)
+{
+    return 0;
+}
+
+gboolean pk_backend_job_get_interactive(PkBackendJob *job)
+{
+    return FALSE;
+}
+
+guint pk_backend_job_get_uid(PkBackendJob *job)
+{
+    return 0;
+}
+
+const gchar *pk_backend_job_get_locale(PkBackendJob *job)
+{
+    return NULL;
+}
+
+const gchar *pk_backend_job_get_frontend_socket(PkBackendJob *job)
+{
+    return NULL;
+}
+
+const gchar *pk_backend_job_get_proxy_ftp(PkBackendJob *job)
+{
+    return NULL;
+}
+
+const gchar *pk_backend_job_get_proxy_http(PkBackendJob *job)
+{
+    return NULL;
+}
+
+void pk_backend_job_package(PkBackendJob *job,
+                            PkInfoEnum info,
+                            const gchar *package_id,
+                            const gchar *summary)
+{
+    ++emitted;
+    if (emittedIds != NULL) {
+        emittedIds->insert(package_id);
+    }
+}
+
+void pk_backend_job_details(PkBackendJob *job,
+                            const gchar *package_id,
+                            const gchar *summary,
+                            const gchar *license,
+                            PkGroupEnum group,
+                            const gchar *description,
+                            const gchar *url,
+                            gulong size)
+{
+    ++emitted;
+}
+
+void pk_backend_job_files(PkBackendJob *job, const gchar *package_id, gchar **files)
+{
+    ++emitted;
+}
+
+void pk_backend_job_update_detail(PkBackendJob *job,
+                                  const gchar *package_id,
+                                  gchar **updates,
+                                  gchar **obsoletes,
+                                  gchar **vendor_urls,
+                                  gchar **bugzilla_urls,
+                                  gchar **cve_urls,
+                                  PkRestartEnum restart,
+                                  const gchar *update_text,
+                                  const gchar *changelog,
+                                  PkUpdateStateEnum state,
+                                  const gchar *issued,
+                                  const gchar *updated)
+{
+    ++emitted;
+}
+
+void pk_backend_job_repo_detail(PkBackendJob *job,
+                                const gchar *repo_id,
+                                const gchar *description,
+                                gboolean enabled)
+{
+}
+
+void pk_backend_job_require_restart(PkBackendJob *job,
+                                    PkRestartEnum restart,
+                                    const gchar *package_id)
+{
+}
+
+void pk_backend_job_media_change_required(PkBackendJob *job,
+                                          PkMediaTypeEnum media_type,
+                                          const gchar *media_id,
+                                          const gchar *media_text)
+{
+}
+
+void pk_backend_job_error_code(PkBackendJob *job,
+                               PkErrorEnum code,
+                               const gchar *details, ...)
+{
+    va_list args;
+    va_start(args, details);
+    g_autofree gchar *message = g_strdup_vprintf(details, args);
+    va_end(args);
+    g_printerr("%s: %s\n", pk_error_enum_to_string(code), message);
+}
+
+void pk_backend_job_set_status(PkBackendJob *job, PkStatusEnum status)
+{
+}
+
+void pk_backend_job_set_percentage(PkBackendJob *job, guint percentage)
+{
+}
+
+void pk_backend_job_set_allow_cancel(PkBackendJob *job, gboolean allow_cancel)
+{
+}
+
+void pk_backend_job_set_item_progress(PkBackendJob *job,
+                                      const gchar *package_id,
+                                      PkStatusEnum status,
+                                      guint percentage)
+{
+}
+
+void pk_backend_job_set_speed(PkBackendJob *job, guint speed)
+{
+}
+
+void pk_backend_job_set_download_size_remaining(PkBackendJob *job, guint64 download_size_remaining)
+{
+}
+
+/* The synthetic system */
+
+static const char *sections[] = {
+    "admin", "devel", "libs", "net", "utils", "x11", "games", "sound", "graphics", "web"
+};
+
+static const char *words[] = {
+    "editor", "server", "library", "toolkit", "daemon", "viewer", "player",
+    "compiler", "driver", "plugin", "client", "parser", "monitor", "shell"
+};
+
+static string packageName(guint i)
+{
+    g_autofree gchar *name = g_strdup_printf("bench-pkg-%06u", i);
+    return name;
+}
+
+static string describe(guint i)
+{
+    g_autofree gchar *text = g_strdup_printf("synthetic %s number %u\n"
+                                             " This package was generated to measure the backend.\n"
+                                             " It provides a %s and nothing else.",
+                                             words[i % G_N_ELEMENTS(words)],
+                                             i,
+                                             words[(i / 7) % G_N_ELEMENTS(words)]);
+    return text;
+}
+
+static vector<guint> dependencyIndexes(guint i)
+{
+    // Only depend on lower numbered packages, so the graph has no cycles
+    vector<guint> depends;
+    if (i > 0) {
+        depends.push_back((i * 7 + 3) % i);
+    }
+    if (i > 1) {
+        depends.push_back(i / 2);
+    }
+    return depends;
+}
+
+static string dependsOn(guint i)
+{
+    const vector<guint> depends = dependencyIndexes(i);
+    string ret;
+    if (!depends.empty()) {
+        ret = packageName(depends[0]);
+    }
+    if (depends.size() > 1) {
+        ret += " (>= 1.0-1), " + packageName(depends[1]);
+    }
+    return ret;
+}
+
+static bool isInstalled(guint i)
+{
+    return i % 5 == 0;
+}
+
+static bool hasUpdate(guint i)
+{
+    return i % 10 == 0;
+}
+
+static void appendStanza(GString *out, guint i, const char *version, bool status)
+{
+    const string name = packageName(i);
+    g_string_append_printf(out, "Package: %s\n", name.c_str());
+    if (status) {
+        g_string_append(out, "Status: install ok installed\n");
+    }
+    g_string_append_printf(out,
+                           "Priority: optional\n"
+                           "Section: %s\n"
+                           "Installed-Size: %u\n"
+                           "Maintainer: PackageKit <packagekit@example.org>\n"
+                           "Architecture: amd64\n"
+                           "Version: %s\n",
+                           sections[i % G_N_ELEMENTS(sections)],
+                           16 + i % 4096,
+                           version);
+    const string depends = dependsOn(i);
+    if (!depends.empty()) {
+        g_string_append_printf(out, "Depends: %s\n", depends.c_str());
+    }
+
+    const string description = describe(i);
+    if (status) {
+        g_string_append_printf(out, "Description: %s\n", description.c_str());
+    } else {
+        g_autofree gchar *md5 = g_compute_checksum_for_string(G_CHECKSUM_MD5,
+                                                              (description + "\n").c_str(),
+                                                              -1);
+        g_string_append_printf(out,
+                               "Filename: pool/main/b/%s/%s_%s_amd64.deb\n"
+                               "Size: %u\n"
+                               "SHA256: %064u\n"
+                               "Description: %s\n"
+                               "Description-md5: %s\n",
+                               name.c_str(),
+                               name.c_str(),
+                               version,
+                               1024 + i,
+                               i,
+                               description.substr(0, description.find('\n')).c_str(),
+                               md5);
+    }
+    g_string_append_c(out, '\n');
+}
+
+static bool writeFile(const string &path, const GString *contents)
+{
+    g_autofree gchar *dir = g_path_get_dirname(path.c_str());
+    g_autoptr(GError) error = NULL;
+    if (g_mkdir_with_parents(dir, 0755) != 0 ||
+            !g_file_set_contents(path.c_str(), contents->str, contents->len, &error)) {
+        g_printerr("Failed to write %s\n", path.c_str());
+        return false;
+    }
+    return true;
+}
+
+static string listsFile(const string &root, const string &path)
+{
+    return root + "/var/lib/apt/lists/" + URItoFileName("file:" + root + "/archive/dists/bench/" + path);
+}
+
+static bool generateSystem(const string &root, guint count)
+{
+    g_autoptr(GString) packages = g_string_new(NULL);
+    g_autoptr(GString) translation = g_string_new(NULL);
+    g_autoptr(GString) status = g_string_new(NULL);
+    for (guint i = 0; i < count; ++i) {
+        // Every other installed package has an update
+        appendStanza(packages, i, hasUpdate(i) ? "1.1-1" : "1.0-1", false);
+
+        const string description = describe(i);
+        g_autofree gchar *md5 = g_compute_checksum_for_string(G_CHECKSUM_MD5,
+                                                              (description + "\n").c_str(),
+                                                              -1);
+        g_string_append_printf(translation,
+                               "Package: %s\nDescription-md5: %s\nDescription-en: %s\n\n",
+                               packageName(i).c_str(),
+                               md5,
+                               description.c_str());
+
+        if (!isInstalled(i)) {
+            continue;
+        }
+
+        appendStanza(status, i, "1.0-1", true);
+
+        const string name = packageName(i);
+        g_autoptr(GString) list = g_string_new(NULL);
+        g_string_append_printf(list,
+                               "/.\n/usr\n/usr/bin\n/usr/bin/%s\n"
+                               "/usr/lib/x86_64-linux-gnu/lib%s.so.1\n"
+                               "/usr/share/doc/%s\n/usr/share/doc/%s/copyright\n"
+                               "/usr/share/man/man1/%s.1.gz\n",
+                               name.c_str(), name.c_str(), name.c_str(), name.c_str(), name.c_str());
+        if (!writeFile(root + "/var/lib/dpkg/info/" + name + ".list", list)) {
+            return false;
+        }
+    }
+
+    g_autofree gchar *sha256 = g_compute_checksum_for_string(G_CHECKSUM_SHA256, packages->str, packages->len);
+    g_autoptr(GString) release = g_string_new(NULL);
+    g_string_append_printf(release,
+                           "Origin: Bench\n"
+                           "Label: Bench\n"
+                           "Suite: bench\n"
+                           "Codename: bench\n"
+                           "Date: Thu, 01 Jan 2026 00:00:00 UTC\n"
+                           "Architectures: amd64\n"
+                           "Components: main\n"
+                           "SHA256:\n"
+                           " %s %" G_GSIZE_FORMAT " main/binary-amd64/Packages\n",
+                           sha256,
+                           packages->len);
+
+    g_autoptr(GString) sources = g_string_new(NULL);
+    g_string_append_printf(sources, "deb [trusted=yes] file:%s/archive bench main\n", root.c_str());
+
+    g_autoptr(GString) empty = g_string_new(NULL);
+    return writeFile(listsFile(root, "main/binary-amd64/Packages"), packages) &&
+            writeFile(listsFile(root, "main/i18n/Translation-en"), translation) &&
+            writeFile(listsFile(root, "Release"), release) &&
+            writeFile(root + "/var/lib/dpkg/status", status) &&
+            writeFile(root + "/etc/apt/sources.list", sources) &&
+            writeFile(root + "/etc/apt/preferences", empty) &&
+            g_mkdir_with_parents((root + "/etc/apt/preferences.d").c_str(), 0755) == 0 &&
+            g_mkdir_with_parents((root + "/etc/apt/sources.list.d").c_str(), 0755) == 0 &&
+            g_mkdir_with_parents((root + "/var/cache/apt/archives/partial").c_str(), 0755) == 0;
+}
+
+static void configureApt(const string &root)
+{
+    _config->Set("Dir", root + "/");
+    _config->Set("Dir::State::status", root + "/var/lib/dpkg/status");
+    _config->Set("Dir::Cache::PackageKit", root + "/var/cache/PackageKit");
+    _config->Set("Dir::Etc::main", "/dev/null");
+    _config->Set("Dir::Etc::parts", root + "/etc/apt/apt.conf.d");
+    _config->Set("APT::Architecture", "amd64");
+    _config->Clear("APT::Architectures");
+    _config->Set("APT::Architectures::", "amd64");
+    _config->Set("Acquire::Languages::", "en");
+}
+
+/* What the roles should find in the synthetic system */
+
+static const char *nameQuery = "pkg-0001";
+static const char *detailsQuery = "toolkit";
+
+// The packages the dependency roles start from, see dependencies()
+static const guint dependencyRoots = 20;
+
+static guint64 countPackages(guint count, const std::function<bool (guint)> &match)
+{
+    guint64 ret = 0;
+    for (guint i = 0; i < count; ++i) {
+        if (match(i)) {
+            ++ret;
+        }
+    }
+    return ret;
+}
+
+static guint64 expectedDepends(guint count)
+{
+    // The union of the dependency closures of the roots
+    const guint step = MAX(count / dependencyRoots, 1);
+    vector<bool> seen(count, false);
+    vector<guint> pending;
+    for (guint i = 0; i < dependencyRoots && i * step < count; ++i) {
+        pending.push_back(i * step);
+    }
+
+    guint64 ret = 0;
+    while (!pending.empty()) {
+        const guint current = pending.back();
+        pending.pop_back();
+        for (guint depend : dependencyIndexes(current)) {
+            if (!seen[depend]) {
+                seen[depend] = true;
+                pending.push_back(depend);
+                ++ret;
+            }
+        }
+    }
+    return ret;
+}
+
+static guint64 expectedRequiredBy(guint count)
+{
+    // The packages directly depending on one of the roots
+    const guint roots = MIN(count, dependencyRoots);
+    return countPackages(count, [roots](guint i) {
+        for (guint depend : dependencyIndexes(i)) {
+            if (depend < roots) {
+                return true;
+            }
+        }
+        return false;
+    });
+}
+
+/* The measurements */
+
+struct Role {
+    const char *name;
+    PkRoleEnum role;
+    std::function<void (AptIntf &)> run;
+    // The number of packages the role must emit
+    guint64 expected;
+    // Whether the role reads the search index, and must find the same
+    // packages without it
+    bool indexed;
+};
+
+static bool measure(const Role &role, guint iterations)
+{
+    vector<gint64> times;
+    guint64 roleAllocations = 0;
+    guint64 roleEmitted = 0;
+    // Start every role without the idle cache left by the previous one
+    AptIntf::freeIdleCache();
+    for (guint i = 0; i < iterations; ++i) {
+        currentRole = role.role;
+        emitted = 0;
+        const guint64 allocationsBefore = allocations.load();
+        const gint64 start = g_get_monotonic_time();
+        {
+            AptIntf apt(NULL);
+            if (!apt.init()) {
+                _error->DumpErrors();
+                return false;
+            }
+            role.run(apt);
+        }
+        times.push_back(g_get_monotonic_time() - start);
+        roleAllocations += allocations.load() - allocationsBefore;
+        roleEmitted = emitted;
+    }
+
+    const gint64 cold = times.front();
+    std::sort(times.begin(), times.end());
+    g_print("%-16s %10" G_GUINT64_FORMAT " %10.2f %10.2f %14" G_GUINT64_FORMAT "\n",
+            role.name,
+            roleEmitted,
+            cold / 1000.0,
+            times[times.size() / 2] / 1000.0,
+            roleAllocations / iterations);
+
+    if (roleEmitted != role.expected) {
+        g_printerr("%s emitted %" G_GUINT64_FORMAT " packages instead of %" G_GUINT64_FORMAT "\n",
+                   role.name,
+                   roleEmitted,
+                   role.expected);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Runs the role once more, gathering the ids of the packages it emits
+ */
+static bool collect(const Role &role, std::set<string> &ids)
+{
+    AptIntf::freeIdleCache();
+    currentRole = role.role;
+    emittedIds = &ids;
+    bool ret;
+    {
+        AptIntf apt(NULL);
+        ret = apt.init();
+        if (ret) {
+            role.run(apt);
+        } else {
+            _error->DumpErrors();
+        }
+    }
+    emittedIds = NULL;
+    return ret;
+}
+
+/**
+ * Checks the role finds the same packages when the backend indexes are
+ * missing and every lookup scans the cache
+ */
+static bool compareWithoutIndexes(const Role &role, const string &root)
+{
+    std::set<string> indexed;
+    std::set<string> linear;
+    const string indexDir = _config->FindDir("Dir::Cache::PackageKit");
+    bool ret = collect(role, indexed);
+    _config->Set("Dir::Cache::PackageKit", root + "/var/cache/PackageKit-unindexed");
+    ret = collect(role, linear) && ret;
+    _config->Set("Dir::Cache::PackageKit", indexDir);
+    AptIntf::freeIdleCache();
+    if (!ret) {
+        return false;
+    }
+
+    if (indexed != linear) {
+        g_printerr("%s found %zu packages with the indexes and %zu without\n",
+                   role.name,
+                   indexed.size(),
+                   linear.size());
+        return false;
+    }
+    return true;
+}
+
+static int removeEntry(const char *path, const struct stat *, int, struct FTW *)
+{
+    return remove(path);
+}
+
+/**
+ * Removes the generated system when the benchmark exits, unless it was
+ * given with --root
+ */
+struct TemporaryRoot {
+    string path;
+    ~TemporaryRoot()
+    {
+        if (!path.empty() &&
+                nftw(path.c_str(), removeEntry, 16, FTW_DEPTH | FTW_PHYS) != 0) {
+            g_printerr("Failed to remove %s\n", path.c_str());
+        }
+    }
+};
+
+static gchar **packageIds(AptIntf &apt, guint count, guint step)
+{
+    GPtrArray *ids = g_ptr_array_new();
+    for (guint i = 0; i < count; ++i) {
+        const string name = packageName(i * step);
+        const pkgCache::PkgIterator pkg = (*apt.aptCacheFile())->FindPkg(name);
+        if (pkg.end()) {
+            continue;
+        }
+        const pkgCache::VerIterator ver = apt.aptCacheFile()->findVer(pkg);
+        if (!ver.end()) {
+            string packageId;
+            g_ptr_array_add(ids, g_strdup(apt.aptCacheFile()->buildPackageId(ver, packageId)));
+        }
+    }
+    g_ptr_array_add(ids, NULL);
+    return reinterpret_cast<gchar**>(g_ptr_array_free(ids, FALSE));
+}
+
+static void dependencies(AptIntf &apt, bool depends, guint count)
+{
+    g_auto(GStrv) ids = packageIds(apt,
+                                   dependencyRoots,
+                                   depends ? MAX(count / dependencyRoots, 1) : 1);
+    PkgList output;
+    for (guint i = 0; ids[i] != NULL; ++i) {
+        const pkgCache::VerIterator ver = apt.aptCacheFile()->resolvePkgID(ids[i]);
+        if (depends) {
+            apt.getDepends(output, ver, true);
+        } else {
+            apt.getRequires(output, ver, false);
+        }
+    }
+    apt.emitPackages(output);
+}
+
+int main(int argc, char **argv)
+{
+    gint packages = 10000;
+    gint iterations = 3;
+    gboolean noIndex = FALSE;
+    g_autofree gchar *root = NULL;
+    const GOptionEntry options[] = {
+        { "packages", 'p', 0, G_OPTION_ARG_INT, &packages,
+          "Number of packages to generate (default 10000)", "N" },
+        { "iterations", 'i', 0, G_OPTION_ARG_INT, &iterations,
+          "Runs of every role (default 3)", "N" },
+        { "root", 'r', 0, G_OPTION_ARG_FILENAME, &root,
+          "Directory of the synthetic system, a temporary one by default", "DIR" },
+        { "no-index", '\0', 0, G_OPTION_ARG_NONE, &noIndex,
+          "Don't build the backend indexes first", NULL },
+        { NULL }
+    };
+
+    g_autoptr(GOptionContext) context = g_option_context_new(NULL);
+    g_option_context_set_summary(context, "Measures the query roles of the APTcc backend");
+    g_option_context_add_main_entries(context, options, NULL);
+    g_autoptr(GError) error = NULL;
+    if (!g_option_context_parse(context, &argc, &argv, &error)) {
+        g_printerr("%s\n", error->message);
+        return EXIT_FAILURE;
+    }
+    if (packages <= 0 || iterations <= 0) {
+        g_printerr("--packages and --iterations must be positive\n");
+        return EXIT_FAILURE;
+    }
+
+    TemporaryRoot temporaryRoot;
+    if (root == NULL) {
+        root = g_dir_make_tmp("aptcc-bench-XXXXXX", &error);
+        if (root == NULL) {
+            g_printerr("%s\n", error->message);
+            return EXIT_FAILURE;
+        }
+        temporaryRoot.path = root;
+    }
+
+    g_print("Generating %d packages in %s\n", packages, root);
+    if (!generateSystem(root, packages)) {
+        return EXIT_FAILURE;
+    }
+
+    if (!pkgInitConfig(*_config)) {
+        _error->DumpErrors();
+        return EXIT_FAILURE;
+    }
+    configureApt(root);
+    if (!pkgInitSystem(*_config, _system)) {
+        _error->DumpErrors();
+        return EXIT_FAILURE;
+    }
+
+    if (!noIndex) {
+        currentRole = PK_ROLE_ENUM_GET_PACKAGES;
+        AptIntf apt(NULL);
+        if (apt.init()) {
+            apt.buildIndexes();
+        }
+    }
+
+    const guint count = packages;
+    const PkBitfield installed = pk_bitfield_value(PK_FILTER_ENUM_INSTALLED);
+    const Role roles[] = {
+        { "search-name", PK_ROLE_ENUM_SEARCH_NAME, [](AptIntf &apt) {
+            PkgList output = apt.searchPackageName({ nameQuery });
+            apt.emitPackages(output);
+        }, countPackages(count, [](guint i) {
+            return packageName(i).find(nameQuery) != string::npos;
+        }), true },
+        { "search-details", PK_ROLE_ENUM_SEARCH_DETAILS, [](AptIntf &apt) {
+            PkgList output = apt.searchPackageDetails({ detailsQuery });
+            apt.emitPackages(output);
+        }, countPackages(count, [](guint i) {
+            return packageName(i).find(detailsQuery) != string::npos ||
+                    describe(i).find(detailsQuery) != string::npos;
+        }), true },
+        { "search-file", PK_ROLE_ENUM_SEARCH_FILE, [](AptIntf &apt) {
+            gchar *values[] = { const_cast<gchar*>("copyright"), NULL };
+            PkgList output = apt.searchPackageFiles(values);
+            apt.emitPackages(output);
+        }, countPackages(count, isInstalled), false },
+        { "depends-on", PK_ROLE_ENUM_DEPENDS_ON, [count](AptIntf &apt) {
+            dependencies(apt, true, count);
+        }, expectedDepends(count), false },
+        { "required-by", PK_ROLE_ENUM_REQUIRED_BY, [count](AptIntf &apt) {
+            dependencies(apt, false, count);
+        }, expectedRequiredBy(count), false },
+        { "filter-packages", PK_ROLE_ENUM_GET_PACKAGES, [installed](AptIntf &apt) {
+            PkgList output = apt.filterPackages(apt.getPackages(), installed);
+            apt.emitPackages(output);
+        }, countPackages(count, isInstalled), false },
+        { "get-updates", PK_ROLE_ENUM_GET_UPDATES, [](AptIntf &apt) {
+            PkgList blocked;
+            PkgList downgrades;
+            PkgList updates = apt.getUpdates(blocked, downgrades);
+            apt.emitUpdates(updates);
+        }, countPackages(count, [](guint i) {
+            return isInstalled(i) && hasUpdate(i);
+        }), false },
+    };
+
+    bool passed = true;
+    g_print("%-16s %10s %10s %10s %14s\n", "role", "emitted", "cold ms", "median ms", "allocations");
+    for (const Role &role : roles) {
+        passed = measure(role, iterations) && passed;
+    }
+
+    if (!noIndex) {
+        for (const Role &role : roles) {
+            if (role.indexed) {
+                passed = compareWithoutIndexes(role, root) && passed;
+            }
+        }
+    }
+
+    AptIntf::freeIdleCache();
+    return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
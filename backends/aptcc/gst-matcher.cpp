@@ -22,6 +22,7 @@
 #include "apt-utils.h"
 
 #include <regex.h>
+#include <cstring>
 #include <gst/gst.h>
 
 static bool inited = false;
@@ -135,23 +136,44 @@ GstMatcher::~GstMatcher()
     }
 }
 
-bool GstMatcher::matches(string record, string arch)
+static const char *findString(const char *start, const char *stop, const string &needle)
 {
+    return static_cast<const char*>(memmem(start, stop - start, needle.data(), needle.size()));
+}
+
+bool GstMatcher::matches(const char *start, const char *stop, const char *arch) const
+{
+    // All the fields we look for start with "Gstreamer-", most records
+    // have none and are rejected here
+    static const string prefix = "Gstreamer-";
+    const char *fields = findString(start, stop, prefix);
+    if (fields == nullptr) {
+        return false;
+    }
+
+    // The version is looked for with its leading newline
+    if (fields > start) {
+        --fields;
+    }
+
     for (const Match &match : m_matches) {
         // Tries to find "Gstreamer-version: xxx"
-        if (record.find(match.version) != string::npos) {
-            size_t found;
-            if (!match.arch.empty() && arch != match.arch)
+        if (findString(fields, stop, match.version) != nullptr) {
+            const char *found;
+            if (!match.arch.empty() && (arch == nullptr || match.arch.compare(arch) != 0))
                     continue;
-            found = record.find(match.type);
+            found = findString(fields, stop, match.type);
             // Tries to find the type "Gstreamer-Uri-Sinks: "
-            if (found != string::npos) {
+            if (found != nullptr) {
                 found += match.type.size(); // skips the "Gstreamer-Uri-Sinks: " string
-                size_t endOfLine;
-                endOfLine = record.find('\n', found);
+                const char *endOfLine;
+                endOfLine = static_cast<const char*>(memchr(found, '\n', stop - found));
+                if (endOfLine == nullptr) {
+                    endOfLine = stop;
+                }
 
                 GstCaps *caps;
-                caps = gst_caps_from_string(record.substr(found, endOfLine - found).c_str());
+                caps = gst_caps_from_string(string(found, endOfLine - found).c_str());
                 if (caps == NULL) {
                     continue;
                 }
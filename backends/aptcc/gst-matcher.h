@@ -43,7 +43,11 @@ public:
     GstMatcher(gchar **values);
     ~GstMatcher();
 
-    bool matches(string record, string arch);
+    /**
+     * Checks whether the package record in [start, stop) provides one
+     * of the requested capabilities, scanning it in place
+     */
+    bool matches(const char *start, const char *stop, const char *arch) const;
     bool hasMatches() const;
 
 private:
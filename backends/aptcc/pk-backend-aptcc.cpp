@@ -23,12 +23,16 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <locale.h>
+#include <unistd.h>
 
 #include <config.h>
 #include <pk-backend.h>
 #include <pk-backend-spawn.h>
 
 #include <apt-pkg/init.h>
+#include <apt-pkg/aptconfiguration.h>
+#include <apt-pkg/fileutl.h>
 
 #include "apt-intf.h"
 #include "apt-cache-file.h"
@@ -61,8 +65,8 @@ const gchar* pk_backend_get_author(PkBackend *backend)
 gboolean
 pk_backend_supports_parallelization (PkBackend *backend)
 {
-    // we need to set this to TRUE as soon as the parallelization work is completed!
-    return FALSE;
+    // Only the query roles really run in parallel, see backend_job_thread()
+    return TRUE;
 }
 
 /**
@@ -91,6 +95,11 @@ void pk_backend_initialize(GKeyFile *conf, PkBackend *backend)
         g_debug("ERROR initializing backend system");
     }
 
+    // Fill apt's cached architectures and languages before jobs running
+    // in parallel read them, the descriptions are looked up per language
+    APT::Configuration::getArchitectures();
+    APT::Configuration::getLanguages();
+
     spawn = pk_backend_spawn_new(conf);
     //     pk_backend_spawn_set_job(spawn, backend);
     pk_backend_spawn_set_name(spawn, "aptcc");
@@ -102,6 +111,7 @@ void pk_backend_initialize(GKeyFile *conf, PkBackend *backend)
 void pk_backend_destroy(PkBackend *backend)
 {
     g_debug("APTcc being destroyed");
+    AptIntf::freeIdleCache();
 }
 
 /**
@@ -169,6 +179,110 @@ gchar** pk_backend_get_mime_types(PkBackend *backend)
     return g_strdupv ((gchar **) mime_types);
 }
 
+/* Query jobs share the lock, every other job holds it alone. A GRWLock
+ * prefers readers, so a stream of queries could keep an install waiting
+ * forever; here new queries wait behind a waiting exclusive job. */
+static GMutex job_mutex;
+static GCond job_cond;
+static guint job_readers = 0;
+static guint job_writers_waiting = 0;
+static bool job_writer = false;
+
+static void backend_job_lock(PkBackendJob *job, bool shared)
+{
+    g_mutex_lock(&job_mutex);
+    if (shared) {
+        if (job_writer || job_writers_waiting > 0) {
+            pk_backend_job_set_status(job, PK_STATUS_ENUM_WAITING_FOR_LOCK);
+            while (job_writer || job_writers_waiting > 0) {
+                g_cond_wait(&job_cond, &job_mutex);
+            }
+        }
+        job_readers++;
+    } else {
+        if (job_writer || job_readers > 0) {
+            pk_backend_job_set_status(job, PK_STATUS_ENUM_WAITING_FOR_LOCK);
+            job_writers_waiting++;
+            while (job_writer || job_readers > 0) {
+                g_cond_wait(&job_cond, &job_mutex);
+            }
+            job_writers_waiting--;
+        }
+        job_writer = true;
+    }
+    g_mutex_unlock(&job_mutex);
+}
+
+static void backend_job_unlock(bool shared)
+{
+    g_mutex_lock(&job_mutex);
+    if (shared) {
+        job_readers--;
+    } else {
+        job_writer = false;
+    }
+    g_cond_broadcast(&job_cond);
+    g_mutex_unlock(&job_mutex);
+}
+
+/**
+ * backend_job_changes_environment:
+ *
+ * Whether the job needs another locale or proxy than the current ones,
+ * setting them affects every thread.
+ */
+static bool backend_job_changes_environment(PkBackendJob *job)
+{
+    const gchar *locale = pk_backend_job_get_locale(job);
+    if (locale != NULL && g_strcmp0(setlocale(LC_ALL, NULL), locale) != 0) {
+        return true;
+    }
+
+    const gchar *http_proxy = pk_backend_job_get_proxy_http(job);
+    if (http_proxy != NULL && g_strcmp0(g_getenv("http_proxy"), http_proxy) != 0) {
+        return true;
+    }
+
+    const gchar *ftp_proxy = pk_backend_job_get_proxy_ftp(job);
+    return ftp_proxy != NULL && g_strcmp0(g_getenv("ftp_proxy"), ftp_proxy) != 0;
+}
+
+/**
+ * backend_job_thread:
+ *
+ * Runs the thread function given as user data once no conflicting job
+ * is running.
+ */
+static void backend_job_thread(PkBackendJob *job, GVariant *params, gpointer user_data)
+{
+    PkBackendJobThreadFunc func = reinterpret_cast<PkBackendJobThreadFunc>(user_data);
+
+    bool shared = AptIntf::canRunInParallel(pk_backend_job_get_role(job));
+    if (shared) {
+        backend_job_lock(job, true);
+        if (backend_job_changes_environment(job)) {
+            backend_job_unlock(true);
+            shared = false;
+        }
+    }
+
+    if (!shared) {
+        backend_job_lock(job, false);
+    }
+
+    func(job, params, NULL);
+
+    backend_job_unlock(shared);
+}
+
+static void backend_thread_create(PkBackendJob *job, PkBackendJobThreadFunc func)
+{
+    pk_backend_job_thread_create(job,
+                                 backend_job_thread,
+                                 reinterpret_cast<gpointer>(func),
+                                 NULL);
+}
+
 /**
  * pk_backend_start_job:
  */
@@ -269,7 +383,7 @@ static void backend_depends_on_or_requires_thread(PkBackendJob *job, GVariant *p
 void pk_backend_depends_on(PkBackend *backend, PkBackendJob *job, PkBitfield filters,
                            gchar **package_ids, gboolean recursive)
 {
-    pk_backend_job_thread_create(job, backend_depends_on_or_requires_thread, NULL, NULL);
+    backend_thread_create(job, backend_depends_on_or_requires_thread);
 }
 
 /**
@@ -281,7 +395,7 @@ void pk_backend_required_by(PkBackend *backend,
                             gchar **package_ids,
                             gboolean recursive)
 {
-    pk_backend_job_thread_create(job, backend_depends_on_or_requires_thread, NULL, NULL);
+    backend_thread_create(job, backend_depends_on_or_requires_thread);
 }
 
 /**
@@ -342,7 +456,7 @@ static void backend_get_files_thread(PkBackendJob *job, GVariant *params, gpoint
  */
 void pk_backend_get_files(PkBackend *backend, PkBackendJob *job, gchar **package_ids)
 {
-    pk_backend_job_thread_create(job, backend_get_files_thread, NULL, NULL);
+    backend_thread_create(job, backend_get_files_thread);
 }
 
 static void backend_get_details_thread(PkBackendJob *job, GVariant *params, gpointer user_data)
@@ -386,7 +500,7 @@ static void backend_get_details_thread(PkBackendJob *job, GVariant *params, gpoi
  */
 void pk_backend_get_update_detail(PkBackend *backend, PkBackendJob *job, gchar **package_ids)
 {
-    pk_backend_job_thread_create(job, backend_get_details_thread, NULL, NULL);
+    backend_thread_create(job, backend_get_details_thread);
 }
 
 /**
@@ -394,12 +508,12 @@ void pk_backend_get_update_detail(PkBackend *backend, PkBackendJob *job, gchar *
  */
 void pk_backend_get_details(PkBackend *backend, PkBackendJob *job, gchar **package_ids)
 {
-    pk_backend_job_thread_create(job, backend_get_details_thread, NULL, NULL);
+    backend_thread_create(job, backend_get_details_thread);
 }
 
 void pk_backend_get_details_local(PkBackend *backend, PkBackendJob *job, gchar **files)
 {
-    pk_backend_job_thread_create(job, backend_get_details_thread, NULL, NULL);
+    backend_thread_create(job, backend_get_details_thread);
 }
 
 static void backend_get_files_local_thread(PkBackendJob *job, GVariant *params, gpointer user_data)
@@ -417,7 +531,7 @@ static void backend_get_files_local_thread(PkBackendJob *job, GVariant *params,
 
 void pk_backend_get_files_local(PkBackend *backend, PkBackendJob *job, gchar **files)
 {
-    pk_backend_job_thread_create(job, backend_get_files_local_thread, NULL, NULL);
+    backend_thread_create(job, backend_get_files_local_thread);
 }
 
 static void backend_get_updates_thread(PkBackendJob *job, GVariant *params, gpointer user_data)
@@ -450,7 +564,7 @@ static void backend_get_updates_thread(PkBackendJob *job, GVariant *params, gpoi
  */
 void pk_backend_get_updates(PkBackend *backend, PkBackendJob *job, PkBitfield filters)
 {
-    pk_backend_job_thread_create(job, backend_get_updates_thread, NULL, NULL);
+    backend_thread_create(job, backend_get_updates_thread);
 }
 
 static void backend_what_provides_thread(PkBackendJob *job, GVariant *params, gpointer user_data)
@@ -493,7 +607,33 @@ void pk_backend_what_provides(PkBackend *backend,
                               PkBitfield filters,
                               gchar **values)
 {
-    pk_backend_job_thread_create(job, backend_what_provides_thread, NULL, NULL);
+    backend_thread_create(job, backend_what_provides_thread);
+}
+
+/**
+ * Makes \a archive available in \a directory, hardlinking it when both
+ * are on the same filesystem
+ * @returns the path of the archive in \a directory, or an empty string
+ */
+static string linkArchive(const string &archive, const string &directory)
+{
+    if (flNotFile(archive) == directory) {
+        return archive;
+    }
+
+    const string target = directory + flNotDir(archive);
+    g_unlink(target.c_str());
+    if (link(archive.c_str(), target.c_str()) == 0) {
+        return target;
+    }
+
+    FileFd from(archive, FileFd::ReadOnly);
+    FileFd to(target, FileFd::WriteOnly | FileFd::Create | FileFd::Empty);
+    if (!CopyFile(from, to)) {
+        _error->Error("Failed to copy %s to %s", archive.c_str(), directory.c_str());
+        return string();
+    }
+    return target;
 }
 
 /**
@@ -503,12 +643,19 @@ static void pk_backend_download_packages_thread(PkBackendJob *job, GVariant *par
 {
     gchar **package_ids;
     const gchar *tmpDir;
+    string archivesDir;
     string directory;
 
     g_variant_get(params, "(^a&ss)",
                   &package_ids,
                   &tmpDir);
-    directory = _config->FindDir("Dir::Cache::archives");
+    // Keep the archives in the apt cache and link them into the
+    // directory the daemon asked for, if any
+    archivesDir = _config->FindDir("Dir::Cache::archives");
+    directory = tmpDir != NULL && tmpDir[0] != '\0' ? string(tmpDir) : archivesDir;
+    if (directory.back() != '/') {
+        directory += '/';
+    }
     pk_backend_job_set_allow_cancel(job, true);
 
     AptIntf *apt = static_cast<AptIntf*>(pk_backend_job_get_user_data(job));
@@ -517,90 +664,101 @@ static void pk_backend_download_packages_thread(PkBackendJob *job, GVariant *par
         return;
     }
 
-    PkBackend *backend = PK_BACKEND(pk_backend_job_get_backend(job));
-    if (pk_backend_is_online(backend)) {
-        pk_backend_job_set_status(job, PK_STATUS_ENUM_QUERY);
-        // Create the progress
-        AcqPackageKitStatus Stat(apt, job);
-
-        // get a fetcher
-        pkgAcquire fetcher(&Stat);
-        gchar *pi;
-
-        // TODO this might be useful when the item is in the cache
-        // 	for (pkgAcquire::ItemIterator I = fetcher.ItemsBegin(); I < fetcher.ItemsEnd();)
-        // 	{
-        // 		if ((*I)->Local == true)
-        // 		{
-        // 			I++;
-        // 			continue;
-        // 		}
-        //
-        // 		// Close the item and check if it was found in cache
-        // 		(*I)->Finished();
-        // 		if ((*I)->Complete == false) {
-        // 			Transient = true;
-        // 		}
-        //
-        // 		// Clear it out of the fetch list
-        // 		delete *I;
-        // 		I = fetcher.ItemsBegin();
-        // 	}
-
-        for (uint i = 0; i < g_strv_length(package_ids); ++i) {
-            pi = package_ids[i];
-            if (pk_package_id_check(pi) == false) {
-                pk_backend_job_error_code(job,
-                                          PK_ERROR_ENUM_PACKAGE_ID_INVALID,
-                                          "%s",
-                                          pi);
-                return;
-            }
+    pk_backend_job_set_status(job, PK_STATUS_ENUM_QUERY);
 
-            if (apt->cancelled()) {
-                break;
-            }
+    PkgList versions;
+    vector<const gchar*> versionIds;
+    for (uint i = 0; i < g_strv_length(package_ids); ++i) {
+        const gchar *pi = package_ids[i];
+        if (pk_package_id_check(pi) == false) {
+            pk_backend_job_error_code(job,
+                                      PK_ERROR_ENUM_PACKAGE_ID_INVALID,
+                                      "%s",
+                                      pi);
+            return;
+        }
 
-            const pkgCache::VerIterator &ver = apt->aptCacheFile()->resolvePkgID(pi);
-            // Ignore packages that could not be found or that exist only due to dependencies.
-            if (ver.end()) {
-                _error->Error("Can't find this package id \"%s\".", pi);
-                continue;
-            } else {
-                if(!ver.Downloadable()) {
-                    _error->Error("No downloadable files for %s,"
-                                  "perhaps it is a local or obsolete" "package?",
-                                  pi);
-                    continue;
-                }
+        const pkgCache::VerIterator &ver = apt->aptCacheFile()->resolvePkgID(pi);
+        // Ignore packages that could not be found or that exist only due to dependencies.
+        if (ver.end()) {
+            _error->Error("Can't find this package id \"%s\".", pi);
+            continue;
+        } else if (!ver.Downloadable()) {
+            _error->Error("No downloadable files for %s,"
+                          "perhaps it is a local or obsolete" "package?",
+                          pi);
+            continue;
+        }
 
-                string storeFileName;
-                if (!apt->getArchive(&fetcher,
-                                     ver,
-                                     directory,
-                                     storeFileName)) {
-                    return;
-                }
+        versions.push_back(ver);
+        versionIds.push_back(pi);
+    }
 
-                gchar **files = (gchar **) g_malloc(2 * sizeof(gchar *));
-                files[0] = g_strdup_printf("%s/%s", directory.c_str(), flNotDir(storeFileName).c_str());
-                files[1] = NULL;
-                pk_backend_job_files(job, pi, files);
-                g_strfreev(files);
-            }
+    // Archives already complete in the cache don't need the network
+    const vector<string> archives = apt->findArchives(versions, archivesDir);
+    vector<size_t> missing;
+    for (size_t i = 0; i < versions.size() && !apt->cancelled(); ++i) {
+        if (archives[i].empty()) {
+            missing.push_back(i);
+            continue;
         }
 
-        if (fetcher.Run() != pkgAcquire::Continue
-                && apt->cancelled() == false) {
-            // We failed and we did not cancel
+        const string file = linkArchive(archives[i], directory);
+        if (file.empty()) {
             show_errors(job, PK_ERROR_ENUM_PACKAGE_DOWNLOAD_FAILED);
             return;
         }
 
-    } else {
+        gchar *files[] = { const_cast<gchar*>(file.c_str()), NULL };
+        pk_backend_job_files(job, versionIds[i], files);
+    }
+
+    if (missing.empty() || apt->cancelled()) {
+        return;
+    }
+
+    PkBackend *backend = PK_BACKEND(pk_backend_job_get_backend(job));
+    if (!pk_backend_is_online(backend)) {
         pk_backend_job_error_code(job,
                                   PK_ERROR_ENUM_NO_NETWORK,
                                   "Cannot download packages whilst offline");
+        return;
+    }
+
+    // Create the progress
+    AcqPackageKitStatus Stat(apt, job);
+
+    // get a fetcher
+    pkgAcquire fetcher(&Stat);
+
+    vector<string> storeFileNames;
+    for (size_t i : missing) {
+        string storeFileName;
+        if (!apt->getArchive(&fetcher,
+                             versions[i],
+                             archivesDir,
+                             storeFileName)) {
+            return;
+        }
+        storeFileNames.push_back(archivesDir + flNotDir(storeFileName));
+    }
+
+    if (fetcher.Run() != pkgAcquire::Continue
+            && apt->cancelled() == false) {
+        // We failed and we did not cancel
+        show_errors(job, PK_ERROR_ENUM_PACKAGE_DOWNLOAD_FAILED);
+        return;
+    }
+
+    for (size_t i = 0; i < missing.size() && !apt->cancelled(); ++i) {
+        const string file = linkArchive(storeFileNames[i], directory);
+        if (file.empty()) {
+            show_errors(job, PK_ERROR_ENUM_PACKAGE_DOWNLOAD_FAILED);
+            return;
+        }
+
+        gchar *files[] = { const_cast<gchar*>(file.c_str()), NULL };
+        pk_backend_job_files(job, versionIds[missing[i]], files);
     }
 }
 
@@ -612,7 +770,7 @@ void pk_backend_download_packages(PkBackend *backend,
                                   gchar **package_ids,
                                   const gchar *directory)
 {
-    pk_backend_job_thread_create(job, pk_backend_download_packages_thread, NULL, NULL);
+    backend_thread_create(job, pk_backend_download_packages_thread);
 }
 
 /**
@@ -647,7 +805,7 @@ static void pk_backend_refresh_cache_thread(PkBackendJob *job, GVariant *params,
  */
 void pk_backend_refresh_cache(PkBackend *backend, PkBackendJob *job, gboolean force)
 {
-    pk_backend_job_thread_create(job, pk_backend_refresh_cache_thread, NULL, NULL);
+    backend_thread_create(job, pk_backend_refresh_cache_thread);
 }
 
 static void pk_backend_resolve_thread(PkBackendJob *job, GVariant *params, gpointer user_data)
@@ -677,7 +835,7 @@ static void pk_backend_resolve_thread(PkBackendJob *job, GVariant *params, gpoin
  */
 void pk_backend_resolve(PkBackend *backend, PkBackendJob *job, PkBitfield filters, gchar **packages)
 {
-    pk_backend_job_thread_create(job, pk_backend_resolve_thread, NULL, NULL);
+    backend_thread_create(job, pk_backend_resolve_thread);
 }
 
 static void pk_backend_search_files_thread(PkBackendJob *job, GVariant *params, gpointer user_data)
@@ -713,7 +871,7 @@ static void pk_backend_search_files_thread(PkBackendJob *job, GVariant *params,
  */
 void pk_backend_search_files(PkBackend *backend, PkBackendJob *job, PkBitfield filters, gchar **values)
 {
-    pk_backend_job_thread_create(job, pk_backend_search_files_thread, NULL, NULL);
+    backend_thread_create(job, pk_backend_search_files_thread);
 }
 
 static void backend_search_groups_thread(PkBackendJob *job, GVariant *params, gpointer user_data)
@@ -744,7 +902,7 @@ static void backend_search_groups_thread(PkBackendJob *job, GVariant *params, gp
  */
 void pk_backend_search_groups(PkBackend *backend, PkBackendJob *job, PkBitfield filters, gchar **values)
 {
-    pk_backend_job_thread_create(job, backend_search_groups_thread, NULL, NULL);
+    backend_thread_create(job, backend_search_groups_thread);
 }
 
 static void backend_search_package_thread(PkBackendJob *job, GVariant *params, gpointer user_data)
@@ -797,7 +955,7 @@ static void backend_search_package_thread(PkBackendJob *job, GVariant *params, g
  */
 void pk_backend_search_names(PkBackend *backend, PkBackendJob *job, PkBitfield filters, gchar **values)
 {
-    pk_backend_job_thread_create(job, backend_search_package_thread, NULL, NULL);
+    backend_thread_create(job, backend_search_package_thread);
 }
 
 /**
@@ -805,7 +963,7 @@ void pk_backend_search_names(PkBackend *backend, PkBackendJob *job, PkBitfield f
  */
 void pk_backend_search_details(PkBackend *backend, PkBackendJob *job, PkBitfield filters, gchar **values)
 {
-    pk_backend_job_thread_create(job, backend_search_package_thread, NULL, NULL);
+    backend_thread_create(job, backend_search_package_thread);
 }
 
 static void backend_manage_packages_thread(PkBackendJob *job, GVariant *params, gpointer user_data)
@@ -914,7 +1072,7 @@ void pk_backend_install_packages(PkBackend *backend,
                                  PkBitfield transaction_flags,
                                  gchar **package_ids)
 {
-    pk_backend_job_thread_create(job, backend_manage_packages_thread, NULL, NULL);
+    backend_thread_create(job, backend_manage_packages_thread);
 }
 
 /**
@@ -925,7 +1083,7 @@ void pk_backend_update_packages(PkBackend *backend,
                                 PkBitfield transaction_flags,
                                 gchar **package_ids)
 {
-    pk_backend_job_thread_create(job, backend_manage_packages_thread, NULL, NULL);
+    backend_thread_create(job, backend_manage_packages_thread);
 }
 
 /**
@@ -936,7 +1094,7 @@ void pk_backend_install_files(PkBackend *backend,
                               PkBitfield transaction_flags,
                               gchar **full_paths)
 {
-    pk_backend_job_thread_create(job, backend_manage_packages_thread, NULL, NULL);
+    backend_thread_create(job, backend_manage_packages_thread);
 }
 
 /**
@@ -949,7 +1107,7 @@ void pk_backend_remove_packages(PkBackend *backend,
                                 gboolean allow_deps,
                                 gboolean autoremove)
 {
-    pk_backend_job_thread_create(job, backend_manage_packages_thread, NULL, NULL);
+    backend_thread_create(job, backend_manage_packages_thread);
 }
 
 /**
@@ -957,7 +1115,7 @@ void pk_backend_remove_packages(PkBackend *backend,
  */
 void pk_backend_repair_system(PkBackend *backend, PkBackendJob *job, PkBitfield transaction_flags)
 {
-    pk_backend_job_thread_create(job, backend_manage_packages_thread, NULL, NULL);
+    backend_thread_create(job, backend_manage_packages_thread);
 }
 
 static void backend_repo_manager_thread(PkBackendJob *job, GVariant *params, gpointer user_data)
@@ -1098,7 +1256,7 @@ static void backend_repo_manager_thread(PkBackendJob *job, GVariant *params, gpo
  */
 void pk_backend_get_repo_list(PkBackend *backend, PkBackendJob *job, PkBitfield filters)
 {
-    pk_backend_job_thread_create(job, backend_repo_manager_thread, NULL, NULL);
+    backend_thread_create(job, backend_repo_manager_thread);
 }
 
 /**
@@ -1106,7 +1264,7 @@ void pk_backend_get_repo_list(PkBackend *backend, PkBackendJob *job, PkBitfield
  */
 void pk_backend_repo_enable(PkBackend *backend, PkBackendJob *job, const gchar *repo_id, gboolean enabled)
 {
-    pk_backend_job_thread_create(job, backend_repo_manager_thread, NULL, NULL);
+    backend_thread_create(job, backend_repo_manager_thread);
 }
 
 /**
@@ -1119,7 +1277,7 @@ pk_backend_repo_remove (PkBackend *backend,
                         const gchar *repo_id,
                         gboolean autoremove)
 {
-    pk_backend_job_thread_create(job, backend_repo_manager_thread, NULL, NULL);
+    backend_thread_create(job, backend_repo_manager_thread);
 }
 
 static void backend_get_packages_thread(PkBackendJob *job, GVariant *params, gpointer user_data)
@@ -1135,11 +1293,7 @@ static void backend_get_packages_thread(PkBackendJob *job, GVariant *params, gpo
         return;
     }
 
-    PkgList output;
-    output = apt->getPackages();
-
-    // It's faster to emit the packages rather here than in the matching part
-    apt->emitPackages(output, filters);
+    apt->emitAllPackages(filters);
 }
 
 /**
@@ -1147,7 +1301,7 @@ static void backend_get_packages_thread(PkBackendJob *job, GVariant *params, gpo
  */
 void pk_backend_get_packages(PkBackend *backend, PkBackendJob *job, PkBitfield filters)
 {
-    pk_backend_job_thread_create(job, backend_get_packages_thread, NULL, NULL);
+    backend_thread_create(job, backend_get_packages_thread);
 }
 
 
@@ -1158,7 +1312,7 @@ void pk_backend_get_packages(PkBackend *backend, PkBackendJob *job, PkBitfield f
 void
 pk_backend_get_categories (PkBackend *backend, PkBackendJob *job)
 {
-    pk_backend_job_thread_create (job, pk_backend_get_categories_thread, NULL, NULL);
+    backend_thread_create(job, pk_backend_get_categories_thread);
 }
 */
 
@@ -89,3 +89,29 @@ void PkgList::removeDuplicates()
     // Remove the duplicated entries
     erase(unique(begin(), end(), result_equality()), end());
 }
+
+PkgSet::PkgSet(pkgCache &cache) :
+    m_packages(cache.HeaderP->PackageCount, false)
+{
+}
+
+bool PkgSet::contains(const pkgCache::PkgIterator &pkg) const
+{
+    return m_packages[pkg->ID];
+}
+
+bool PkgSet::insert(const pkgCache::PkgIterator &pkg)
+{
+    if (m_packages[pkg->ID]) {
+        return false;
+    }
+    m_packages[pkg->ID] = true;
+    return true;
+}
+
+void PkgSet::insert(const PkgList &list)
+{
+    for (const pkgCache::VerIterator &ver : list) {
+        m_packages[ver.ParentPkg()->ID] = true;
+    }
+}
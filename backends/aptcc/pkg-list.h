@@ -46,4 +46,33 @@ public:
     void removeDuplicates();
 };
 
+/**
+ * Set of packages keyed by their ID in the package cache, used to keep
+ * track of visited packages while walking dependencies
+ */
+class PkgSet
+{
+public:
+    PkgSet(pkgCache &cache);
+
+    /**
+     * Return if the given package was added to the set
+     */
+    bool contains(const pkgCache::PkgIterator &pkg) const;
+
+    /**
+     * Add a package to the set
+     * @returns false if the package was already in the set
+     */
+    bool insert(const pkgCache::PkgIterator &pkg);
+
+    /**
+     * Add the packages of all versions in the given list
+     */
+    void insert(const PkgList &list);
+
+private:
+    vector<bool> m_packages;
+};
+
 #endif // PKG_LIST_H
@@ -35,6 +35,7 @@
 #include <string>
 #include <sys/vfs.h>
 #include <unistd.h>
+#include <unordered_set>
 #include <vector>
 
 #include <glib.h>
@@ -70,6 +71,7 @@
 #include <zypp/TmpPath.h>
 #include <zypp/ZYpp.h>
 #include <zypp/ZYppCallbacks.h>
+#include <zypp/ZConfig.h>
 #include <zypp/ZYppFactory.h>
 #include <zypp/base/Algorithm.h>
 #include <zypp/base/Functional.h>
@@ -87,7 +89,6 @@
 #include <zypp/target/rpm/RpmDb.h>
 #include <zypp/target/rpm/RpmException.h>
 #include <zypp/target/rpm/RpmHeader.h>
-#include <zypp/target/rpm/librpmDb.h>
 #include <zypp/ui/Selectable.h>
 
 using namespace std;
@@ -149,6 +150,11 @@ public:
  */
 gchar * _repoName;
 
+/* When the repositories were last refreshed and loaded into the pool,
+ * by alias, and the rpm database they were loaded with */
+static map<string, time_t> _repoVerified;
+static Date _rpmDbVerified;
+
 /* We need to track the number of packages to download in global scope */
 guint _dl_count = 0;
 guint _dl_progress = 0;
@@ -749,22 +755,6 @@ zypp_build_pool (ZYpp::Ptr zypp, gboolean include_local)
 	return zypp->pool ();
 }
 
-/**
-  * Return the rpmHeader of a package
-  */
-target::rpm::RpmHeader::constPtr
-zypp_get_rpmHeader (const string &name, Edition edition)
-{
-	target::rpm::librpmDb::db_const_iterator it;
-	target::rpm::RpmHeader::constPtr result = new target::rpm::RpmHeader ();
-
-	for (it.findPackage (name, edition); *it; ++it) {
-		result = *it;
-	}
-
-	return result;
-}
-
 /**
   * Return the PkEnumGroup of the given PoolItem.
   */
@@ -850,17 +840,17 @@ zypp_get_packages_by_file (ZYpp::Ptr zypp,
 			   const gchar *search_file,
 			   vector<sat::Solvable> &ret)
 {
-	ResPool pool = zypp_build_pool (zypp, TRUE);
-
-	string file (search_file);
+	zypp_build_pool (zypp, TRUE);
 
-	target::rpm::librpmDb::db_const_iterator it;
-	target::rpm::RpmHeader::constPtr result = new target::rpm::RpmHeader ();
+	// the file lists of the installed packages are in the system repo
+	Repository system = sat::Pool::instance ().findSystemRepo ();
+	if (system) {
+		sat::LookupAttr look (sat::SolvAttr::filelist, system);
+		look.setStrMatcher (StrMatcher (search_file, Match::STRING | Match::FILES));
 
-	for (it.findByFile (search_file); *it; ++it) {
-		for (ResPool::byName_iterator it2 = pool.byNameBegin (it->tag_name ()); it2 != pool.byNameEnd (it->tag_name ()); it2++) {
-			if ((*it2)->isSystem ())
-				ret.push_back ((*it2)->satSolvable ());
+		for (sat::LookupAttr::iterator it = look.begin (); it != look.end (); ++it) {
+			if (ret.empty () || ret.back () != it.inSolvable ())
+				ret.push_back (it.inSolvable ());
 		}
 	}
 
@@ -1117,6 +1107,37 @@ zypp_backend_package (PkBackendJob *job, PkInfoEnum info,
 	g_free (id);
 }
 
+/**
+ * Identifies a solvable the way sameNVRA compares them, plus whether
+ * it is a source package
+ */
+struct ZyppNVRAKey {
+	sat::detail::IdType ident;
+	sat::detail::IdType edition;
+	sat::detail::IdType arch;
+	bool source;
+
+	explicit ZyppNVRAKey (const sat::Solvable &item)
+		: ident (item.ident ().id ()),
+		  edition (item.edition ().id ()),
+		  arch (item.arch ().id ()),
+		  source (isKind<SrcPackage>(item)) {}
+
+	bool operator== (const ZyppNVRAKey &other) const {
+		return ident == other.ident && edition == other.edition &&
+		       arch == other.arch && source == other.source;
+	}
+};
+
+struct ZyppNVRAKeyHash {
+	size_t operator() (const ZyppNVRAKey &key) const {
+		size_t h = key.ident;
+		h = h * 31 + key.edition;
+		h = h * 31 + key.arch;
+		return h * 2 + key.source;
+	}
+};
+
 /*
  * Emit signals for the packages, -but- if we have an installed package
  * we don't notify the client that the package is also available, since
@@ -1127,7 +1148,7 @@ zypp_emit_filtered_packages_in_list (PkBackendJob *job, PkBitfield filters, cons
 {
 	typedef vector<sat::Solvable>::const_iterator sat_it_t;
 
-	vector<sat::Solvable> installed;
+	unordered_set<ZyppNVRAKey, ZyppNVRAKeyHash> installed;
 
 	// always emit system installed packages first
 	for (sat_it_t it = v.begin (); it != v.end (); ++it) {
@@ -1137,24 +1158,16 @@ zypp_emit_filtered_packages_in_list (PkBackendJob *job, PkBitfield filters, cons
 
 		zypp_backend_package (job, PK_INFO_ENUM_INSTALLED, *it,
 				      make<ResObject>(*it)->summary().c_str());
-		installed.push_back (*it);
+		installed.insert (ZyppNVRAKey (*it));
 	}
 
 	// then available packages later
 	for (sat_it_t it = v.begin (); it != v.end (); ++it) {
-		gboolean match;
-
 		if (it->isSystem() ||
 		    zypp_filter_solvable (filters, *it))
 			continue;
 
-		match = FALSE;
-		for (sat_it_t i = installed.begin (); !match && i != installed.end (); i++) {
-			match = it->sameNVRA (*i) &&
-				!(!isKind<SrcPackage>(*it) ^
-				  !isKind<SrcPackage>(*i));
-		}
-		if (!match) {
+		if (installed.find (ZyppNVRAKey (*it)) == installed.end ()) {
 			zypp_backend_package (job, PK_INFO_ENUM_AVAILABLE, *it,
 					      make<ResObject>(*it)->summary().c_str());
 		}
@@ -1609,6 +1622,7 @@ zypp_refresh_cache (PkBackendJob *job, ZYpp::Ptr zypp, gboolean force)
 	}
 	// load installed packages to pool
 	target->load ();
+	_rpmDbVerified = target->rpmDb ().timestamp ();
 
 	pk_backend_job_set_status (job, PK_STATUS_ENUM_REFRESH_CACHE);
 	pk_backend_job_set_percentage (job, 0);
@@ -1679,7 +1693,8 @@ zypp_refresh_cache (PkBackendJob *job, ZYpp::Ptr zypp, gboolean force)
 			// Refreshing metadata
 			g_free (_repoName);
 			_repoName = g_strdup (repo.alias ().c_str ());
-			zypp_refresh_meta_and_cache (manager, repo, force);
+			if (zypp_refresh_meta_and_cache (manager, repo, force))
+				_repoVerified[repo.alias ()] = time (NULL);
 		} catch (const Exception &ex) {
 			if (repo_messages == NULL) {
 				repo_messages = g_strdup_printf ("%s: %s%s", repo.alias ().c_str (), ex.asUserString ().c_str (), "\n");
@@ -1703,6 +1718,59 @@ zypp_refresh_cache (PkBackendJob *job, ZYpp::Ptr zypp, gboolean force)
 	return TRUE;
 }
 
+/**
+  * refresh the enabled repositories unless all of them were refreshed
+  * within the cache age of the job, the repo.refresh.delay of zypp if
+  * the client didn't set one
+  */
+static gboolean
+zypp_refresh_cache_if_expired (PkBackendJob *job, ZYpp::Ptr zypp)
+{
+	if (zypp == NULL)
+		return FALSE;
+
+	guint cache_age = pk_backend_job_get_cache_age (job);
+	if (cache_age == G_MAXUINT)
+		cache_age = ZConfig::instance ().repo_refresh_delay () * 60;
+	time_t now = time (NULL);
+
+	// installed or removed packages since, the system repo is stale
+	Target_Ptr target = zypp->getTarget ();
+	if (!target || _rpmDbVerified != target->rpmDb ().timestamp ())
+		return zypp_refresh_cache (job, zypp, FALSE);
+
+	set<string> aliases;
+	try {
+		RepoManager manager;
+		for (RepoManager::RepoConstIterator it = manager.repoBegin (); it != manager.repoEnd (); ++it) {
+			if (!it->enabled () || it->baseUrlsEmpty () ||
+			    it->baseUrlsBegin ()->schemeIsVolatile ())
+				continue;
+			aliases.insert (it->alias ());
+
+			// the repos zypp_refresh_cache would refresh
+			if (!it->autorefresh ())
+				continue;
+			map<string, time_t>::const_iterator verified = _repoVerified.find (it->alias ());
+			if (verified == _repoVerified.end () ||
+			    now < verified->second || (guint64) (now - verified->second) >= cache_age)
+				return zypp_refresh_cache (job, zypp, FALSE);
+		}
+	} catch (const Exception &ex) {
+		return zypp_refresh_cache (job, zypp, FALSE);
+	}
+
+	// repos removed or disabled since have to leave the pool
+	for (const Repository &poolrepo : zypp->pool ().knownRepositories ()) {
+		if (!poolrepo.isSystemRepo () &&
+		    aliases.find (poolrepo.alias ()) == aliases.end ())
+			return zypp_refresh_cache (job, zypp, FALSE);
+	}
+
+	MIL << "repositories verified within " << cache_age << "s, reusing the pool" << endl;
+	return TRUE;
+}
+
 /**
   * helper to simplify returning errors
   */
@@ -2329,7 +2397,7 @@ backend_get_updates_thread (PkBackendJob *job, GVariant *params, gpointer user_d
 	pk_backend_job_set_percentage (job, 0);
 
 	// refresh the repos before checking for updates
-	if (!zypp_refresh_cache (job, zypp, FALSE)) {
+	if (!zypp_refresh_cache_if_expired (job, zypp)) {
 		return;
 	}
 
@@ -2892,7 +2960,6 @@ static void
 backend_find_packages_thread (PkBackendJob *job, GVariant *params, gpointer user_data)
 {
 	MIL << endl;
-	const gchar *search;
 	PkRoleEnum role;
 
 	PkBitfield _filters;
@@ -2909,11 +2976,10 @@ backend_find_packages_thread (PkBackendJob *job, GVariant *params, gpointer user
 	}
 
 	// refresh the repos before searching
-	if (!zypp_refresh_cache (job, zypp, FALSE)) {
+	if (!zypp_refresh_cache_if_expired (job, zypp)) {
 		return;
 	}
 
-	search = values[0];  //Fixme - support the possible multiple values (logical OR search)
 	role = pk_backend_job_get_role(job);
 
 	pk_backend_job_set_status (job, PK_STATUS_ENUM_QUERY);
@@ -2921,8 +2987,10 @@ backend_find_packages_thread (PkBackendJob *job, GVariant *params, gpointer user
 
 	vector<sat::Solvable> v;
 
+	// a single pass over the pool answers all the terms
 	PoolQuery q;
-	q.addString( search ); // may be called multiple times (OR'ed)
+	for (guint i = 0; values[i] != NULL; i++)
+		q.addString( values[i] ); // OR'ed
 	q.setCaseSensitive( true );
 	q.setMatchSubstring();
 
@@ -3174,29 +3242,22 @@ backend_get_files_thread (PkBackendJob *job, GVariant *params, gpointer user_dat
 			return;
 		}
 
-		string temp;
-		if (solvable.isSystem ()){
-			try {
-				target::rpm::RpmHeader::constPtr rpmHeader = zypp_get_rpmHeader (solvable.name (), solvable.edition ());
-				list<string> files = rpmHeader->tag_filenames ();
-
-				for (list<string>::iterator it = files.begin (); it != files.end (); ++it) {
-					temp.append (*it);
-					temp.append (";");
-				}
-
-			} catch (const target::rpm::RpmException &ex) {
-				zypp_backend_finished_error (job, PK_ERROR_ENUM_REPO_NOT_FOUND,
-							     "Couldn't open rpm-database");
-				return;
-			}
-		} else {
-			temp = "Only available for installed packages";
+		if (!solvable.isSystem ()) {
+			const gchar *to_strv[] = { "Only available for installed packages", NULL };
+			pk_backend_job_files (job, package_ids[i], (gchar **) to_strv);
+			continue;
 		}
 
-		const gchar *to_strv[] = { NULL, NULL };
-		to_strv[0] = temp.c_str ();
-		pk_backend_job_files (job, package_ids[i], (gchar **) to_strv);	// file_list
+		// read the file list from the solv file of the system repo
+		// rather than the rpm database
+		GPtrArray *files = g_ptr_array_new_with_free_func (g_free);
+		sat::LookupAttr look (sat::SolvAttr::filelist, solvable);
+		for (sat::LookupAttr::iterator it = look.begin (); it != look.end (); ++it)
+			g_ptr_array_add (files, g_strdup (it.c_str ()));
+		g_ptr_array_add (files, NULL);
+
+		pk_backend_job_files (job, package_ids[i], (gchar **) files->pdata);
+		g_ptr_array_unref (files);
 	}
 }
 
@@ -3605,7 +3666,7 @@ backend_download_packages_thread (PkBackendJob *job, GVariant *params, gpointer
 		return;
 	}
 
-	if (!zypp_refresh_cache (job, zypp, FALSE)) {
+	if (!zypp_refresh_cache_if_expired (job, zypp)) {
 		return;
 	}
 